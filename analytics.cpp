@@ -0,0 +1,524 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * analytics.cpp
+ * Implimentation of post-run analytics.
+ *
+ * Each chunk is grouped with a counting sort, then every metric is gathered
+ * into one contiguous array of doubles, group after group, and the kernels
+ * run over each group's slice. Chunk statistics are merged into the running
+ * totals with Chan's parallel variance formula. Times are integers well below
+ * 2^53, so chunk sums, minimums and maximums are exact in doubles.
+ *
+ * The kernels use AVX when the compiler targets it (make NATIVE=1), SSE2
+ * otherwise on x86-64, and plain loops elsewhere.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include "process_structs.h"
+#include "thread_export.h"
+#include "simulation.h"
+#include "analytics.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::cout;
+using std::shared_ptr;
+
+// Columns used by the metrics
+static const int COLUMN_PROCESS_TYPE = 2;
+static const int COLUMN_ARRIVAL = 3;
+static const int COLUMN_START = 4;
+static const int COLUMN_END = 5;
+static const int COLUMN_CPU = 6;
+static const int COLUMN_IO = 7;
+static const int COLUMN_READY_WAIT = 8;
+
+static void sum_min_max(double const * values, size_t count, double& sum, double& min, double& max)
+{
+  /**
+   * Sum, minimum and maximum of count > 0 values.
+   */
+  size_t i = 0;
+  sum = 0;
+  min = max = values[0];
+#if defined(__AVX__)
+  if (count >= 4)
+  {
+    __m256d sums = _mm256_setzero_pd();
+    __m256d mins = _mm256_loadu_pd(values);
+    __m256d maxs = mins;
+    for (; i + 4 <= count; i += 4)
+    {
+      __m256d v = _mm256_loadu_pd(values + i);
+      sums = _mm256_add_pd(sums, v);
+      mins = _mm256_min_pd(mins, v);
+      maxs = _mm256_max_pd(maxs, v);
+    }
+    double lanes[3][4];
+    _mm256_storeu_pd(lanes[0], sums);
+    _mm256_storeu_pd(lanes[1], mins);
+    _mm256_storeu_pd(lanes[2], maxs);
+    for (int lane = 0; lane < 4; lane++)
+    {
+      sum += lanes[0][lane];
+      min = std::min(min, lanes[1][lane]);
+      max = std::max(max, lanes[2][lane]);
+    }
+  }
+#elif defined(__SSE2__)
+  if (count >= 2)
+  {
+    __m128d sums = _mm_setzero_pd();
+    __m128d mins = _mm_loadu_pd(values);
+    __m128d maxs = mins;
+    for (; i + 2 <= count; i += 2)
+    {
+      __m128d v = _mm_loadu_pd(values + i);
+      sums = _mm_add_pd(sums, v);
+      mins = _mm_min_pd(mins, v);
+      maxs = _mm_max_pd(maxs, v);
+    }
+    double lanes[3][2];
+    _mm_storeu_pd(lanes[0], sums);
+    _mm_storeu_pd(lanes[1], mins);
+    _mm_storeu_pd(lanes[2], maxs);
+    for (int lane = 0; lane < 2; lane++)
+    {
+      sum += lanes[0][lane];
+      min = std::min(min, lanes[1][lane]);
+      max = std::max(max, lanes[2][lane]);
+    }
+  }
+#endif
+  for (; i < count; i++)
+  {
+    sum += values[i];
+    min = std::min(min, values[i]);
+    max = std::max(max, values[i]);
+  }
+}
+
+static double squared_deviation(double const * values, size_t count, double mean)
+{
+  /**
+   * Sum of (value - mean)^2.
+   */
+  size_t i = 0;
+  double total = 0;
+#if defined(__AVX__)
+  __m256d totals = _mm256_setzero_pd();
+  __m256d means = _mm256_set1_pd(mean);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m256d deviation = _mm256_sub_pd(_mm256_loadu_pd(values + i), means);
+    totals = _mm256_add_pd(totals, _mm256_mul_pd(deviation, deviation));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, totals);
+  total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+  __m128d totals = _mm_setzero_pd();
+  __m128d means = _mm_set1_pd(mean);
+  for (; i + 2 <= count; i += 2)
+  {
+    __m128d deviation = _mm_sub_pd(_mm_loadu_pd(values + i), means);
+    totals = _mm_add_pd(totals, _mm_mul_pd(deviation, deviation));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, totals);
+  total = lanes[0] + lanes[1];
+#endif
+  for (; i < count; i++) total += (values[i] - mean) * (values[i] - mean);
+  return total;
+}
+
+static void bucket_indices(double const * values, size_t count, double width, int* buckets)
+{
+  /**
+   * Histogram bucket of each value, floor(value / width) clamped to
+   * [0, MAX_HISTOGRAM_BUCKETS - 1]. Division (not a reciprocal multiply)
+   * keeps values on a bucket boundary in the right bucket.
+   */
+  const double last = ThreadAnalytics::MAX_HISTOGRAM_BUCKETS - 1;
+  size_t i = 0;
+#if defined(__AVX__)
+  __m256d widths = _mm256_set1_pd(width);
+  __m256d zeros = _mm256_setzero_pd();
+  __m256d lasts = _mm256_set1_pd(last);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m256d bucket = _mm256_div_pd(_mm256_loadu_pd(values + i), widths);
+    bucket = _mm256_min_pd(_mm256_max_pd(bucket, zeros), lasts);
+    _mm_storeu_si128((__m128i*) (buckets + i), _mm256_cvttpd_epi32(bucket));
+  }
+#elif defined(__SSE2__)
+  __m128d widths = _mm_set1_pd(width);
+  __m128d zeros = _mm_setzero_pd();
+  __m128d lasts = _mm_set1_pd(last);
+  for (; i + 2 <= count; i += 2)
+  {
+    __m128d bucket = _mm_div_pd(_mm_loadu_pd(values + i), widths);
+    bucket = _mm_min_pd(_mm_max_pd(bucket, zeros), lasts);
+    _mm_storel_epi64((__m128i*) (buckets + i), _mm_cvttpd_epi32(bucket));
+  }
+#endif
+  for (; i < count; i++) buckets[i] = (int) std::min(std::max(values[i] / width, 0.0), last);
+}
+
+static int64_t floor_div(int64_t value, int64_t width)
+{
+  int64_t quotient = value / width;
+  if ((value % width != 0) && ((value < 0) != (width < 0))) quotient--;
+  return quotient;
+}
+
+const size_t ThreadTable::CHUNK_ROWS;
+const int ThreadAnalytics::MAX_HISTOGRAM_BUCKETS;
+
+ThreadTable::ThreadTable()
+  : rows(0)
+{
+  for (int c = 0; c < EXPORT_COLUMNS; c++) columns[c].resize(CHUNK_ROWS);
+}
+
+void ThreadTable::clear()
+{
+  rows = 0;
+}
+
+MetricStats::MetricStats()
+  : count(0), sum(0), mean(0), m2(0), min(0), max(0)
+{}
+
+void MetricStats::merge(long long count_arg, int64_t sum_arg, double m2_arg, int64_t min_arg, int64_t max_arg)
+{
+  /**
+   * Combine with the statistics of another set of count_arg values.
+   */
+  if (count_arg == 0) return;
+  double other_mean = (double) sum_arg / count_arg;
+  if (count == 0)
+  {
+    count = count_arg; sum = sum_arg; mean = other_mean; m2 = m2_arg; min = min_arg; max = max_arg;
+    return;
+  }
+  long long total = count + count_arg;
+  double delta = other_mean - mean;
+  m2 += m2_arg + delta * delta * ((double) count * count_arg / total);
+  mean += delta * count_arg / total;
+  count = total;
+  sum += sum_arg;
+  min = std::min(min, min_arg);
+  max = std::max(max, max_arg);
+}
+
+ThreadAnalytics::ThreadAnalytics(int key_column_arg, int64_t key_width_arg, int histogram_metric_arg, int64_t histogram_width_arg)
+  : key_column(key_column_arg), key_width(key_width_arg), histogram_metric(histogram_metric_arg),
+    histogram_width(histogram_width_arg), total_rows(0), chunk_number(0),
+    histogram(MAX_HISTOGRAM_BUCKETS), row_group(ThreadTable::CHUNK_ROWS), order(ThreadTable::CHUNK_ROWS),
+    values(ThreadTable::CHUNK_ROWS), buckets(ThreadTable::CHUNK_ROWS)
+{}
+
+int ThreadAnalytics::group_of(int64_t key)
+{
+  /**
+   * Global index of the group for key, created on first use.
+   */
+  auto found = group_index.find(key);
+  if (found != group_index.end()) return found->second;
+  int group = group_keys.size();
+  group_index[key] = group;
+  group_keys.push_back(key);
+  group_stats.push_back(std::vector<MetricStats>(ANALYTICS_METRICS));
+  group_stamp.push_back(-1);
+  group_local.push_back(0);
+  return group;
+}
+
+void ThreadAnalytics::add_table(ThreadTable const & table)
+{
+  /**
+   * Accumulate a chunk of at most CHUNK_ROWS threads.
+   */
+  size_t rows = table.rows;
+  if (rows == 0) return;
+  chunk_number++;
+  total_rows += rows;
+  // Local group of every row, only groups present in this chunk are visited below
+  touched_groups.clear();
+  int64_t last_key = 0; int last_local = -1;
+  for (size_t r = 0; r < rows; r++)
+  {
+    int64_t key = floor_div(table.columns[key_column][r], key_width);
+    if (last_local < 0 || key != last_key)
+    {
+      int group = group_of(key);
+      if (group_stamp[group] != chunk_number)
+      {
+        group_stamp[group] = chunk_number;
+        group_local[group] = touched_groups.size();
+        touched_groups.push_back(group);
+      }
+      last_key = key;
+      last_local = group_local[group];
+    }
+    row_group[r] = last_local;
+  }
+  // Counting sort of the rows by group
+  group_offsets.assign(touched_groups.size() + 1, 0);
+  for (size_t r = 0; r < rows; r++) group_offsets[row_group[r] + 1]++;
+  for (size_t g = 0; g < touched_groups.size(); g++) group_offsets[g + 1] += group_offsets[g];
+  {
+    std::vector<size_t> next(group_offsets.begin(), group_offsets.end() - 1);
+    for (size_t r = 0; r < rows; r++) order[next[row_group[r]]++] = r;
+  }
+  int64_t const * arrival = &table.columns[COLUMN_ARRIVAL][0];
+  for (int metric = 0; metric < ANALYTICS_METRICS; metric++)
+  {
+    // Gather the metric in group order
+    switch (metric)
+    {
+      case 0:
+        for (size_t i = 0; i < rows; i++) values[i] = table.columns[COLUMN_START][order[i]] - arrival[order[i]];
+        break;
+      case 1:
+        for (size_t i = 0; i < rows; i++) values[i] = table.columns[COLUMN_END][order[i]] - arrival[order[i]];
+        break;
+      default:
+        int column = (metric == 2) ? COLUMN_CPU : (metric == 3) ? COLUMN_IO : COLUMN_READY_WAIT;
+        for (size_t i = 0; i < rows; i++) values[i] = table.columns[column][order[i]];
+    }
+    for (size_t g = 0; g < touched_groups.size(); g++)
+    {
+      size_t begin = group_offsets[g], count = group_offsets[g + 1] - begin;
+      double sum, min, max;
+      sum_min_max(&values[begin], count, sum, min, max);
+      double m2 = squared_deviation(&values[begin], count, sum / count);
+      group_stats[touched_groups[g]][metric].merge(count, (int64_t) sum, m2, (int64_t) min, (int64_t) max);
+    }
+    if (metric == histogram_metric)
+    {
+      bucket_indices(&values[0], rows, (double) histogram_width, &buckets[0]);
+      for (size_t i = 0; i < rows; i++) histogram[buckets[i]]++;
+    }
+  }
+}
+
+void ThreadAnalytics::output()
+{
+  /**
+   * Output per group statistics in key order, then the histogram.
+   */
+  cout << "ANALYSIS OF " << total_rows << " THREAD(S) BY " << EXPORT_COLUMN_NAMES[key_column];
+  if (key_width != 1) cout << " / " << key_width;
+  cout << ":\n\n";
+  std::vector<int> groups(group_keys.size());
+  for (int g = 0; g < groups.size(); g++) groups[g] = g;
+  std::sort(groups.begin(), groups.end(), [&](int a, int b) { return group_keys[a] < group_keys[b]; });
+  for (auto group = groups.begin(); group != groups.end(); group++)
+  {
+    int64_t key = group_keys[*group];
+    cout << EXPORT_COLUMN_NAMES[key_column] << " ";
+    if (key_width == 1) cout << key;
+    else cout << "[" << key * key_width << ", " << (key + 1) * key_width << ")";
+    if (key_column == COLUMN_PROCESS_TYPE && key_width == 1 && key >= 0 && key <= 3)
+    {
+      cout << " [" << Simulation::process_type_string(key) << "]";
+    }
+    cout << " (" << group_stats[*group][0].count << " thread(s)):\n";
+    cout << std::left << std::setw(16) << "    Metric" << std::right;
+    cout << std::setw(14) << "Sum" << std::setw(11) << "Min" << std::setw(11) << "Max";
+    cout << std::setw(13) << "Mean" << std::setw(13) << "Std dev" << "\n";
+    for (int metric = 0; metric < ANALYTICS_METRICS; metric++)
+    {
+      MetricStats const & stats = group_stats[*group][metric];
+      cout << std::left << std::setw(16) << "    " + std::string(ANALYTICS_METRIC_NAMES[metric]) << std::right;
+      cout << std::setw(14) << stats.sum << std::setw(11) << stats.min << std::setw(11) << stats.max;
+      cout << std::setw(13) << std::setprecision(2) << std::fixed << stats.mean;
+      cout << std::setw(13) << std::setprecision(2) << std::fixed << std::sqrt(stats.m2 / stats.count) << "\n";
+    }
+    cout << "\n";
+  }
+  if (histogram_metric < 0) return;
+  cout << "HISTOGRAM OF " << ANALYTICS_METRIC_NAMES[histogram_metric] << " (width " << histogram_width << "):\n";
+  int last = MAX_HISTOGRAM_BUCKETS - 1;
+  while (last > 0 && histogram[last] == 0) last--;
+  for (int bucket = 0; bucket <= last; bucket++)
+  {
+    std::string range = (bucket == MAX_HISTOGRAM_BUCKETS - 1)
+      ? std::to_string(bucket * histogram_width) + "+"
+      : "[" + std::to_string(bucket * histogram_width) + ", " + std::to_string((bucket + 1) * histogram_width) + ")";
+    cout << "    " << std::left << std::setw(24) << range + ":" << std::right << std::setw(9) << histogram[bucket] << "\n";
+  }
+  cout << "\n";
+}
+
+int export_column_index(std::string name)
+{
+  /**
+   * Returns index of the export column called name, -1 if there is none.
+   */
+  for (int c = 0; c < EXPORT_COLUMNS; c++) if (name == EXPORT_COLUMN_NAMES[c]) return c;
+  return -1;
+}
+
+int analytics_metric_index(std::string name)
+{
+  /**
+   * Returns index of the metric called name, -1 if there is none.
+   */
+  for (int m = 0; m < ANALYTICS_METRICS; m++) if (name == ANALYTICS_METRIC_NAMES[m]) return m;
+  return -1;
+}
+
+void analyze_processes(std::vector<shared_ptr<Process> > const & processes, ThreadAnalytics& analytics)
+{
+  /**
+   * Analyze every thread of a finished simulation, in the export row order.
+   */
+  ThreadTable table;
+  for (auto proc = processes.begin(); proc != processes.end(); proc++)
+  {
+    Process const & process = **proc;
+    for (auto thr = process.threads.begin(); thr != process.threads.end(); thr++)
+    {
+      Thread const & thread = **thr;
+      int64_t row[EXPORT_COLUMNS] = {
+        process.id, thread.id, process.type, thread.arrival_time, thread.start_time, thread.end_time,
+        thread.total_cpu_time, thread.total_io_time, thread.ready_wait_time
+      };
+      for (int c = 0; c < EXPORT_COLUMNS; c++) table.columns[c][table.rows] = row[c];
+      if (++table.rows == ThreadTable::CHUNK_ROWS)
+      {
+        analytics.add_table(table);
+        table.clear();
+      }
+    }
+  }
+  analytics.add_table(table);
+}
+
+static bool analyze_binary(FILE* file, ExportHeader const & header, std::string path, ThreadAnalytics& analytics)
+{
+  /**
+   * Analyze the records after a binary export header, one chunk at a time.
+   *
+   * Returns false if the file is truncated or of another version.
+   */
+  if (header.version != 1 || header.columns != EXPORT_COLUMNS)
+  {
+    std::cout << "ERROR INVALID EXPORT FILE " << path << "\n";
+    return false;
+  }
+  ThreadTable table;
+  std::vector<int64_t> records(ThreadTable::CHUNK_ROWS * EXPORT_COLUMNS);
+  uint64_t remaining = header.rows;
+  while (remaining > 0)
+  {
+    size_t rows = std::min<uint64_t>(remaining, ThreadTable::CHUNK_ROWS);
+    if (fread(&records[0], sizeof(int64_t) * EXPORT_COLUMNS, rows, file) != rows)
+    {
+      std::cout << "ERROR TRUNCATED EXPORT FILE " << path << "\n";
+      return false;
+    }
+    // Rows to columns
+    for (int c = 0; c < EXPORT_COLUMNS; c++)
+    {
+      int64_t* column = &table.columns[c][0];
+      int64_t const * record = &records[c];
+      for (size_t r = 0; r < rows; r++, record += EXPORT_COLUMNS) column[r] = *record;
+    }
+    table.rows = rows;
+    analytics.add_table(table);
+    remaining -= rows;
+  }
+  return true;
+}
+
+static bool analyze_csv(FILE* file, std::string path, ThreadAnalytics& analytics)
+{
+  /**
+   * Analyze a CSV export: the column name line, then one line of
+   * EXPORT_COLUMNS integers per thread, gathered into chunks as they are read.
+   *
+   * Returns false if the file is not a CSV export.
+   */
+  std::string names;
+  for (int c = 0; c < EXPORT_COLUMNS; c++) names += std::string(EXPORT_COLUMN_NAMES[c]) + ((c == EXPORT_COLUMNS - 1) ? "\n" : ",");
+  char line[512]; // A row of EXPORT_COLUMNS int64 is under 200 characters
+  if (fgets(line, sizeof(line), file) == nullptr || names != line)
+  {
+    std::cout << "ERROR INVALID EXPORT FILE " << path << " (not a -x binary or CSV export)\n";
+    return false;
+  }
+  ThreadTable table;
+  while (fgets(line, sizeof(line), file) != nullptr)
+  {
+    char* field = line;
+    for (int c = 0; c < EXPORT_COLUMNS; c++)
+    {
+      char* field_end;
+      table.columns[c][table.rows] = strtoll(field, &field_end, 10);
+      bool last = (c == EXPORT_COLUMNS - 1);
+      if (field_end == field || (last ? (*field_end != '\n' && *field_end != '\0') : *field_end != ','))
+      {
+        std::cout << "ERROR INVALID EXPORT FILE " << path << " ROW: " << line;
+        return false;
+      }
+      field = field_end + 1;
+    }
+    if (++table.rows == ThreadTable::CHUNK_ROWS)
+    {
+      analytics.add_table(table);
+      table.clear();
+    }
+  }
+  analytics.add_table(table);
+  return true;
+}
+
+bool analyze_file(std::string path, ThreadAnalytics& analytics)
+{
+  /**
+   * Analyze a file written by export_threads, binary or CSV, one chunk of
+   * records at a time.
+   *
+   * Returns false if the file could not be read.
+   */
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+  {
+    std::cout << "ERROR CANNOT READ EXPORT FILE " << path << "\n";
+    return false;
+  }
+  ExportHeader header;
+  bool ok;
+  if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "OSSIMTHR", 8) == 0)
+  {
+    ok = analyze_binary(file, header, path, analytics);
+  }
+  else
+  {
+    rewind(file);
+    ok = analyze_csv(file, path, analytics);
+  }
+  fclose(file);
+  return ok;
+}
@@ -0,0 +1,89 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * analytics.h
+ *
+ * Defines post-run analytics over per-thread results. Threads are processed
+ * in fixed size chunks stored column by column (the export columns), so the
+ * same stage runs over a finished simulation or an exported binary file of
+ * any size. Per group statistics and histograms are computed with SIMD
+ * kernels over contiguous arrays.
+ */
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "process_structs.h"
+#include "thread_export.h"
+
+// A chunk of thread results, one array per column in EXPORT_COLUMN_NAMES order
+struct ThreadTable
+{
+  ThreadTable();
+  void clear();
+  size_t rows;
+  std::vector<int64_t> columns[EXPORT_COLUMNS];
+  static const size_t CHUNK_ROWS = 1 << 16;
+};
+
+// Statistics derived from the columns
+static const int ANALYTICS_METRICS = 5;
+static const char* const ANALYTICS_METRIC_NAMES[ANALYTICS_METRICS] = {
+  "response", "turnaround", "cpu", "io", "ready_wait"
+};
+
+struct MetricStats
+{
+  MetricStats();
+  void merge(long long count_arg, int64_t sum_arg, double m2_arg, int64_t min_arg, int64_t max_arg);
+  long long count;
+  int64_t sum;
+  double mean;
+  double m2; // Sum of squared deviations from the mean
+  int64_t min;
+  int64_t max;
+};
+
+class ThreadAnalytics
+{
+public:
+  ThreadAnalytics(int key_column_arg, int64_t key_width_arg, int histogram_metric_arg, int64_t histogram_width_arg);
+  void add_table(ThreadTable const & table);
+  void output();
+  static const int MAX_HISTOGRAM_BUCKETS = 4096; // The last bucket holds everything above
+private:
+  int group_of(int64_t key);
+  int key_column;
+  int64_t key_width;
+  int histogram_metric; // -1 for no histogram
+  int64_t histogram_width;
+  long long total_rows;
+  long long chunk_number;
+  std::unordered_map<int64_t, int> group_index;
+  std::vector<int64_t> group_keys;
+  std::vector<std::vector<MetricStats> > group_stats;
+  std::vector<long long> histogram;
+  // Scratch space reused by every chunk
+  std::vector<long long> group_stamp;     // Chunk a group was last seen in
+  std::vector<int> group_local;           // Index of the group within that chunk
+  std::vector<int> touched_groups;
+  std::vector<int> row_group;
+  std::vector<size_t> group_offsets;
+  std::vector<size_t> order;
+  std::vector<double> values;
+  std::vector<int> buckets;
+};
+
+int export_column_index(std::string name);
+int analytics_metric_index(std::string name);
+void analyze_processes(std::vector<std::shared_ptr<Process> > const & processes, ThreadAnalytics& analytics);
+bool analyze_file(std::string path, ThreadAnalytics& analytics);
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * event_queue.cpp
+ * Implimentation of the event queue. Without the wheel every event goes in
+ * the due heap, which is then exactly the heap the simulator always used.
+ * With it, events within the wheel horizon are
+ * bucketed by time in a hierarchical timing wheel (O(1) insert, expiry by
+ * cascading buckets down a level), everything else waits in a heap. Events
+ * for the current time are drained into a small heap so the merged order is
+ * exactly that of CompareEventsByArrivalTime.
+ */
+
+
+#include <vector>
+#include <queue>
+#include <cassert>
+#include <limits>
+#include <algorithm>
+#include "process_structs.h"
+#include "event_queue.h"
+
+bool CompareEventsByArrivalTime::operator()(Event const & e1, Event const & e2)
+{
+   /**
+   * Comparator for event priority queue
+   * Sorts by earliest time, then lowest Event::Type number, then highest thread id,
+   * then insertion order when the wheel is used (thread ids are only unique within
+   * a process, the heap alone leaves the rest of the tie to its layout)
+   */
+  if (e1.time == e2.time)
+  {
+    if (e1.type != e2.type) return e1.type > e2.type;
+    if (e1.thread->id != e2.thread->id) return e1.thread->id < e2.thread->id;
+    return e1.seq > e2.seq;
+  }
+  else return e1.time > e2.time;
+}
+
+EventQueue::EventQueue()
+  : use_wheel(false), wheel(LEVELS * SLOTS), wheel_time(0), wheel_count(0), due_time(-1), next_seq(0)
+{
+  for (int level = 0; level < LEVELS; level++) occupied[level] = 0;
+}
+
+void EventQueue::set_wheel(bool enabled)
+{
+  /**
+   * Choose the timing wheel or the single heap, only while the queue is empty.
+   */
+  assert(empty());
+  use_wheel = enabled;
+}
+
+void EventQueue::push(Event event)
+{
+  /**
+   * Add event to the queue. Events for the time currently being drained go
+   * straight to the due heap, events sharing the wheel's top level go in the
+   * wheel and the rest go in the far heap.
+   *
+   * Events earlier than the due time also go to the due heap. Only the
+   * simulation's fast path raises those: a held event is handed back when a
+   * streaming watermark ends run_until, after the due heap was filled with a
+   * later time, and may be earlier than the wheel time. Streamed arrivals never
+   * take this branch, run_until checks the watermark with next_time(), which
+   * leaves the wheel in place.
+   */
+  if (not use_wheel)
+  {
+    due_events.push(event);
+    return;
+  }
+  event.seq = next_seq++;
+  if (not due_events.empty() && event.time <= due_time)
+  {
+    due_events.push(event);
+    return;
+  }
+  assert(event.time >= wheel_time);
+  if ((event.time >> (SLOT_BITS * LEVELS)) == (wheel_time >> (SLOT_BITS * LEVELS))) insert_wheel(event);
+  else far_events.push(event);
+}
+
+void EventQueue::insert_wheel(Event const & event)
+{
+  /**
+   * Place event in the lowest wheel level where its time shares all higher
+   * bits with the wheel time. Such a slot only ever holds times later than
+   * the wheel time, so the lowest occupied slot of the lowest occupied level
+   * always holds the earliest events.
+   */
+  int level = 0;
+  while (level < LEVELS - 1
+    && (event.time >> (SLOT_BITS * (level + 1))) != (wheel_time >> (SLOT_BITS * (level + 1))))
+  {
+    level++;
+  }
+  int slot = (event.time >> (SLOT_BITS * level)) & (SLOTS - 1);
+  wheel[level * SLOTS + slot].push_back(event);
+  occupied[level] |= uint64_t(1) << slot;
+  wheel_count++;
+}
+
+Event const & EventQueue::top()
+{
+  /**
+   * Returns the earliest event, preparing the due heap if needed.
+   */
+  if (due_events.empty()) collect_due();
+  assert(not due_events.empty());
+  return due_events.top();
+}
+
+SimTime EventQueue::next_time() const
+{
+  /**
+   * Time of the earliest event without moving the wheel, so checking it never
+   * advances the wheel time past a streaming watermark (later arrivals must not
+   * be earlier than the wheel time). The queue must not be empty.
+   *
+   * Returns the earliest event time.
+   */
+  if (not due_events.empty()) return due_events.top().time;
+  SimTime earliest = std::numeric_limits<SimTime>::max();
+  if (not far_events.empty()) earliest = far_events.top().time;
+  if (wheel_count != 0)
+  {
+    int level = 0;
+    while (occupied[level] == 0) level++;
+    int slot = __builtin_ctzll(occupied[level]);
+    std::vector<Event> const & bucket = wheel[level * SLOTS + slot];
+    for (auto it = bucket.begin(); it != bucket.end(); it++) earliest = std::min(earliest, it->time);
+  }
+  return earliest;
+}
+
+void EventQueue::pop()
+{
+  /**
+   * Remove the earliest event.
+   */
+  if (due_events.empty()) collect_due();
+  due_events.pop();
+}
+
+bool EventQueue::empty() const
+{
+  return due_events.empty() && wheel_count == 0 && far_events.empty();
+}
+
+void EventQueue::collect_due()
+{
+  /**
+   * Find the earliest time across the wheel and the far heap and move every
+   * event at that time into the due heap. Higher wheel levels are cascaded
+   * down until the earliest time sits in a level 0 slot, unless the far heap
+   * already holds something earlier than the slot's range.
+   */
+  while (wheel_count != 0)
+  {
+    int level = 0;
+    while (occupied[level] == 0) level++;
+    int slot = __builtin_ctzll(occupied[level]);
+    int shift = SLOT_BITS * level;
+    SimTime slot_start = ((wheel_time >> (shift + SLOT_BITS)) << (shift + SLOT_BITS)) | (SimTime(slot) << shift);
+    if (not far_events.empty() && far_events.top().time < slot_start)
+    {
+      take_due(far_events.top().time);
+      return;
+    }
+    if (level == 0)
+    {
+      take_due(slot_start);
+      return;
+    }
+    // Cascade the slot down, its events now share the higher bits with the wheel time
+    std::vector<Event> & bucket = wheel[level * SLOTS + slot];
+    std::vector<Event> events;
+    events.swap(bucket);
+    occupied[level] &= ~(uint64_t(1) << slot);
+    wheel_count -= events.size();
+    wheel_time = slot_start;
+    for (auto it = events.begin(); it != events.end(); it++) insert_wheel(*it);
+    events.clear();
+    bucket.swap(events); // Hand the storage back to the slot
+  }
+  if (not far_events.empty()) take_due(far_events.top().time);
+}
+
+void EventQueue::take_due(SimTime time)
+{
+  /**
+   * Move all events at time into the due heap.
+   */
+  due_time = time;
+  int slot = time & (SLOTS - 1);
+  if ((occupied[0] & (uint64_t(1) << slot))
+    && (time >> SLOT_BITS) == (wheel_time >> SLOT_BITS))
+  {
+    std::vector<Event> & bucket = wheel[slot];
+    for (auto it = bucket.begin(); it != bucket.end(); it++) due_events.push(*it);
+    wheel_count -= bucket.size();
+    bucket.clear();
+    occupied[0] &= ~(uint64_t(1) << slot);
+    wheel_time = time;
+  }
+  while (not far_events.empty() && far_events.top().time == time)
+  {
+    due_events.push(far_events.top());
+    far_events.pop();
+  }
+  // An empty wheel can be moved up to the current time
+  if (wheel_count == 0) wheel_time = time;
+}
@@ -0,0 +1,58 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * event_queue.h
+ *
+ * Defines the simulation event queue. By default a single binary heap, as
+ * the simulator always used, so events that tie on time, type and thread id
+ * come out in the same order as before. With set_wheel, short-horizon events
+ * are kept in a hierarchical timing wheel, far-future events in a secondary
+ * heap, and ties are broken by insertion order instead.
+ */
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <vector>
+#include <queue>
+#include <cstdint>
+#include "process_structs.h"
+
+struct CompareEventsByArrivalTime{
+  bool operator()(Event const & e1, Event const & e2);
+};
+
+class EventQueue
+{
+public:
+  EventQueue();
+  void set_wheel(bool enabled);
+  void push(Event event);
+  Event const & top();
+  SimTime next_time() const;
+  void pop();
+  bool empty() const;
+private:
+  bool use_wheel;
+  void insert_wheel(Event const & event);
+  void collect_due();
+  void take_due(SimTime time);
+  // Wheel geometry: LEVELS levels of SLOTS slots, each level covering SLOT_BITS more bits of time
+  static const int SLOT_BITS = 6;
+  static const int SLOTS = 1 << SLOT_BITS;
+  static const int LEVELS = 4;
+  std::vector<std::vector<Event> > wheel;
+  uint64_t occupied[LEVELS];
+  SimTime wheel_time;
+  int wheel_count;
+  // Events at the current time, ordered by CompareEventsByArrivalTime (every event without the wheel)
+  std::priority_queue<Event, std::vector<Event>, CompareEventsByArrivalTime> due_events;
+  SimTime due_time;
+  // Events beyond the wheel horizon
+  std::priority_queue<Event, std::vector<Event>, CompareEventsByArrivalTime> far_events;
+  long long next_seq;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * io_device.cpp
+ * Implimentation of IO devices. Requests are queued in a deque (FIFO) or a
+ * multimap keyed by position (elevator), so every submit and completion is
+ * O(1) or O(log n) in the queue length.
+ */
+
+
+#include <deque>
+#include <map>
+#include <iostream>
+#include <iomanip>
+#include "process_structs.h"
+#include "io_device.h"
+
+using std::cout;
+
+IoDevice::IoDevice(int id_arg, int channels_arg, int discipline_arg)
+  : id(id_arg), channels(channels_arg), discipline(discipline_arg),
+    requests(0), busy_time(0), total_queue_delay(0), max_queue_delay(0),
+    busy_channels(0), head_position(0), moving_up(true)
+{}
+
+bool IoDevice::submit(IoRequest const & request, SimTime time)
+{
+  /**
+   * Issue a request, starting it if a channel is free and queueing it
+   * otherwise.
+   *
+   * Returns true if the request started, and will complete io_time from now.
+   */
+  requests++;
+  if (busy_channels < channels)
+  {
+    start(request, time);
+    return true;
+  }
+  if (discipline == ELEVATOR) elevator_queue.insert(std::make_pair(request.burst->position, request));
+  else fifo_queue.push_back(request);
+  return false;
+}
+
+bool IoDevice::complete(IoRequest& next_request, SimTime time)
+{
+  /**
+   * Free the channel of a completed request and start the next queued one.
+   * The elevator serves the nearest position in its direction of travel and
+   * turns around when nothing is left ahead of it.
+   *
+   * Returns true if next_request was started, and will complete io_time from now.
+   */
+  busy_channels--;
+  if (discipline == ELEVATOR)
+  {
+    if (elevator_queue.empty()) return false;
+    auto next = elevator_queue.end();
+    if (moving_up)
+    {
+      next = elevator_queue.lower_bound(head_position);
+      if (next == elevator_queue.end()) moving_up = false;
+    }
+    if (not moving_up)
+    {
+      next = elevator_queue.upper_bound(head_position);
+      if (next == elevator_queue.begin())
+      {
+        moving_up = true;
+      }
+      else next = elevator_queue.lower_bound((--next)->first);
+    }
+    next_request = next->second;
+    elevator_queue.erase(next);
+  }
+  else
+  {
+    if (fifo_queue.empty()) return false;
+    next_request = fifo_queue.front();
+    fifo_queue.pop_front();
+  }
+  start(next_request, time);
+  return true;
+}
+
+void IoDevice::start(IoRequest const & request, SimTime time)
+{
+  busy_channels++;
+  head_position = request.burst->position;
+  busy_time = time_add(busy_time, request.burst->io_time);
+  SimTime queue_delay = time - request.submit_time;
+  total_queue_delay = time_add(total_queue_delay, queue_delay);
+  if (queue_delay > max_queue_delay) max_queue_delay = queue_delay;
+}
+
+void IoDevice::output_stats(SimTime elapsed_time)
+{
+  /**
+   * Final data for the device. Utilization is busy channel time over
+   * channels * elapsed time.
+   */
+  double utilization = (elapsed_time == 0) ? 0 : 100.0 * busy_time / ((double) channels * elapsed_time);
+  double average_queue_delay = (requests == 0) ? 0 : (double) total_queue_delay / requests;
+  cout << "DEVICE " << id << " [" << channels << " channel(s), "
+       << ((discipline == ELEVATOR) ? "ELEVATOR" : "FIFO") << "]:\n";
+  cout << std::left << std::setw(24) << "    Requests:";
+  cout << std::right << std::setw(9) << requests << "\n";
+  cout << std::left << std::setw(24) << "    Utilization:";
+  cout << std::right << std::setw(8) << std::setprecision(2) << std::fixed << utilization << "%\n";
+  cout << std::left << std::setw(24) << "    Avg queue delay:";
+  cout << std::right << std::setw(9) << std::setprecision(2) << std::fixed << average_queue_delay << "\n";
+  cout << std::left << std::setw(24) << "    Max queue delay:";
+  cout << std::right << std::setw(9) << max_queue_delay << "\n";
+  cout << "\n";
+}
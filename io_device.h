@@ -0,0 +1,55 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * io_device.h
+ *
+ * Defines IO devices with a finite number of channels. Bursts tagged with a
+ * device wait for a free channel, in FIFO order or elevator (LOOK) order by
+ * position, instead of all completing io_time after they are issued.
+ */
+
+#ifndef IO_DEVICE_H
+#define IO_DEVICE_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include "process_structs.h"
+
+struct IoRequest
+{
+  std::shared_ptr<Thread> thread;
+  std::shared_ptr<Burst> burst;
+  SimTime submit_time;
+};
+
+struct IoDevice
+{
+  IoDevice(int id_arg, int channels_arg, int discipline_arg);
+  bool submit(IoRequest const & request, SimTime time);
+  bool complete(IoRequest& next_request, SimTime time);
+  void output_stats(SimTime elapsed_time);
+  int id;
+  int channels;
+  int discipline;
+  // Statistics
+  long long requests;
+  SimTime busy_time;        // Summed over channels
+  SimTime total_queue_delay;
+  SimTime max_queue_delay;
+  // Queue disciplines
+  static const int FIFO = 0;
+  static const int ELEVATOR = 1;
+private:
+  void start(IoRequest const & request, SimTime time);
+  int busy_channels;
+  std::deque<IoRequest> fifo_queue;
+  std::multimap<SimTime, IoRequest> elevator_queue; // By position, equal positions in arrival order
+  SimTime head_position;
+  bool moving_up;
+};
+
+#endif
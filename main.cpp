@@ -5,7 +5,8 @@
  * 
  * main.cpp
  * Reads in process/thread/burst data from input file, parses command line arguments, builds process data
- * structures and passes to simlation, and launches simulation.
+ * structures and passes to simlation, and launches simulation. In streaming mode thread records are read
+ * from a pipe or Unix socket and fed to the simulation as they arrive.
  */
 
 
@@ -16,11 +17,24 @@
 #include <string>
 #include <memory>
 #include <iomanip>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <limits>
 #include <cassert>
+#include <cstring>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "process_structs.h"
 #include "simulation.h"
+#include "replication.h"
+#include "trace_import.h"
+#include "multicore.h"
+#include "warmup.h"
+#include "analytics.h"
 
 using std::vector; using std::string; using std::shared_ptr;
 
@@ -39,6 +53,40 @@ void display_help()
   cout << indent << indent << "Output additional per-thread statistics for arrival time, service time, etc.\n";
   cout << indent << "-a\n";
   cout << indent << indent << "The scheduling algorithm to use. One of FCFs, RR, PRIORITY, or CUSTOM.\n";
+  cout << indent << "-m, --max_age\n";
+  cout << indent << indent << "CUSTOM only: time a thread may wait before it is moved to the aged queue, checked when the next thread is chosen (default 0, aging off).\n";
+  cout << indent << "-s, --stream SOURCE\n";
+  cout << indent << indent << "Stream thread records from SOURCE (- for stdin, a pipe, or a Unix socket) instead of an input file.\n";
+  cout << indent << "-w, --window W\n";
+  cout << indent << indent << "Streaming only: output windowed metrics every W time units (default 100).\n";
+  cout << indent << "-r, --replicate N\n";
+  cout << indent << indent << "Run N (at least 2) perturbed replicas in parallel and output the mean and 95% confidence interval of all totals.\n";
+  cout << indent << "-S, --seed S\n";
+  cout << indent << indent << "Replication seed (default 1).\n";
+  cout << indent << "-p, --perturb MODE\n";
+  cout << indent << indent << "Replication perturbation. One of jitter (arrivals), resample (burst lengths), or bootstrap (threads).\n";
+  cout << indent << "-x, --export_threads FILE\n";
+  cout << indent << indent << "Write per-thread results to FILE, as CSV if FILE ends in .csv, fixed-width binary otherwise.\n";
+  cout << indent << "-l, --timeline FILE\n";
+  cout << indent << indent << "Record the CPU timeline (RUNNING/WARMUP/DISPATCH/IDLE intervals) to FILE, Chrome trace JSON if FILE ends in .json.\n";
+  cout << indent << "-A, --affinity W\n";
+  cout << indent << indent << "Prefer ready threads of the loaded process while the algorithm's choice has waited less than W.\n";
+  cout << indent << "-W, --warmup decay:MAX:TAU|linear:MAX:RAMP[:process]\n";
+  cout << indent << indent << "Charge a cache warm-up penalty on dispatch, up to MAX, growing with the time the thread (or process) was off the CPU.\n";
+  cout << indent << "-d, --device ID:CHANNELS[:fifo|elevator]\n";
+  cout << indent << indent << "Add an IO device, bursts tagged with ID queue for one of its CHANNELS (repeatable).\n";
+  cout << indent << "-c, --cpus N\n";
+  cout << indent << indent << "Simulate N cores in parallel, each process pinned to the least loaded core when it arrives.\n";
+  cout << indent << "-i, --import T:P\n";
+  cout << indent << indent << "Input file is an ftrace or perf sched trace, simulated with thread/process switch overheads T and P (microseconds).\n";
+  cout << indent << "-q, --fast_queue\n";
+  cout << indent << indent << "Use the timing wheel event queue, faster on large inputs. Events tied on time, type and thread id run in the order they were raised.\n";
+  cout << indent << "-g, --group_by COLUMN[:W]\n";
+  cout << indent << indent << "After the run, output per group statistics of the threads, grouped by an export column (bucketed by W). Default process_type.\n";
+  cout << indent << "-H, --histogram METRIC:W\n";
+  cout << indent << indent << "After the run, output a histogram of METRIC (response, turnaround, cpu, io or ready_wait) with bucket width W.\n";
+  cout << indent << "-y, --analyze FILE\n";
+  cout << indent << indent << "Analyze a binary or CSV --export_threads FILE (with -g and -H) instead of simulating, no input file needed.\n";
   cout << indent << "Final argument should be the input .txt file\n";
   cout << indent << indent << "This file should inlcude process, thread, and burst data.\n";
   cout << indent << indent << "See README for specific formatting\n";
@@ -72,6 +120,84 @@ vector<string> tokenize(string str)
   return words;
 }
 
+bool add_device(string spec, Simulation& simulation)
+{
+  /**
+   * Parses a -d --device argument, ID:CHANNELS[:fifo|elevator], and adds the
+   * device to the simulation.
+   *
+   * Returns false if the argument is malformed or the id is negative.
+   */
+  std::replace(spec.begin(), spec.end(), ':', ' ');
+  vector<string> fields = tokenize(spec);
+  if (fields.size() < 2 || fields.size() > 3) return false;
+  int discipline = IoDevice::FIFO;
+  if (fields.size() == 3)
+  {
+    if (fields[2] == "elevator") discipline = IoDevice::ELEVATOR;
+    else if (fields[2] != "fifo") return false;
+  }
+  int id = std::stoi(fields[0]);
+  int channels = std::stoi(fields[1]);
+  if (id < 0 || channels < 1) return false; // Negative ids mark untagged bursts
+  simulation.add_device(id, channels, discipline);
+  return true;
+}
+
+shared_ptr<ThreadAnalytics> make_analytics(string group_by, string histogram_spec)
+{
+  /**
+   * Parses the -g --group_by argument, COLUMN[:W], and the -H --histogram
+   * argument, METRIC:W (empty for no histogram).
+   *
+   * Returns the analytics stage, nullptr (after an error) if an argument is malformed.
+   */
+  std::replace(group_by.begin(), group_by.end(), ':', ' ');
+  vector<string> fields = tokenize(group_by);
+  int key_column = fields.empty() ? -1 : export_column_index(fields[0]);
+  long long key_width = (fields.size() == 2) ? std::stoll(fields[1]) : 1;
+  if (key_column < 0 || fields.size() > 2 || key_width < 1)
+  {
+    std::cout << "ERROR INVALID GROUP " << group_by << "\n";
+    return nullptr;
+  }
+  int histogram_metric = -1; long long histogram_width = 1;
+  if (not histogram_spec.empty())
+  {
+    string spec = histogram_spec;
+    std::replace(spec.begin(), spec.end(), ':', ' ');
+    fields = tokenize(spec);
+    if (fields.size() == 2)
+    {
+      histogram_metric = analytics_metric_index(fields[0]);
+      histogram_width = std::stoll(fields[1]);
+    }
+    if (fields.size() != 2 || histogram_metric < 0 || histogram_width < 1)
+    {
+      std::cout << "ERROR INVALID HISTOGRAM " << histogram_spec << "\n";
+      return nullptr;
+    }
+  }
+  return std::make_shared<ThreadAnalytics>(key_column, key_width, histogram_metric, histogram_width);
+}
+
+SimTime parse_time(string word)
+{
+  /**
+   * Parses a time value, failing loudly if it does not fit in SimTime
+   * (only possible in a COMPACT_TIME build).
+   *
+   * Returns the parsed time.
+   */
+  long long value = std::stoll(word);
+  if (value < std::numeric_limits<SimTime>::min() || value > std::numeric_limits<SimTime>::max())
+  {
+    std::cerr << "ERROR TIME OUT OF RANGE: " << word << ", rebuild without COMPACT_TIME\n";
+    exit(1);
+  }
+  return value;
+}
+
 shared_ptr<Thread> readin_thread(std::istream& input_stream, vector<string> thread_params, shared_ptr<Process> process, int thread_id)
 {
   /**
@@ -79,7 +205,7 @@ shared_ptr<Thread> readin_thread(std::istream& input_stream, vector<string> thre
    * 
    * Returns pointer to thread object.
    */
-  int thread_arrival_time = std::stoi(thread_params[0]);
+  SimTime thread_arrival_time = parse_time(thread_params[0]);
   shared_ptr<Thread> thread = std::make_shared<Thread>(thread_arrival_time, thread_id, process);
   for (int i = 0; i < std::stoi(thread_params[1]); )
   {
@@ -90,9 +216,11 @@ shared_ptr<Thread> readin_thread(std::istream& input_stream, vector<string> thre
     {
       vector<string> burst_params = tokenize(line);
       if (burst_params.size() == 1) burst_params.push_back("0");
-      int cpu_time = std::stoi(burst_params[0]);
-      int io_time = std::stoi(burst_params[1]);
+      SimTime cpu_time = parse_time(burst_params[0]);
+      SimTime io_time = parse_time(burst_params[1]);
       shared_ptr<Burst> burst = std::make_shared<Burst>(cpu_time, io_time, thread);
+      if (burst_params.size() >= 3) burst->device = std::stoi(burst_params[2]);
+      if (burst_params.size() >= 4) burst->position = parse_time(burst_params[3]);
       thread->bursts.push_back(burst);
       i++; // Only increment when we actually read in a burst
     }
@@ -126,6 +254,132 @@ shared_ptr<Process> readin_process(std::istream& input_stream, vector<string> pr
   return process;
 }
 
+class FdStreamBuf : public std::streambuf
+{
+  /**
+   * Minimal read-only stream buffer over a file descriptor, used for Unix sockets.
+   */
+public:
+  FdStreamBuf(int fd_arg) : fd(fd_arg) {}
+  ~FdStreamBuf() { close(fd); }
+protected:
+  int underflow()
+  {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0) return traits_type::eof();
+    setg(buffer, buffer, buffer + n);
+    return traits_type::to_int_type(*gptr());
+  }
+private:
+  int fd;
+  char buffer[1 << 16];
+};
+
+class FdInputStream : public std::istream
+{
+public:
+  FdInputStream(int fd) : std::istream(nullptr), buf(fd) { rdbuf(&buf); }
+private:
+  FdStreamBuf buf;
+};
+
+shared_ptr<std::istream> open_stream_source(string source)
+{
+  /**
+   * Opens a streaming source: - for stdin, a Unix socket path, or any other
+   * readable path (named pipe or file).
+   *
+   * Returns pointer to the input stream, nullptr if it could not be opened.
+   */
+  if (source == "-") return shared_ptr<std::istream>(&std::cin, [](std::istream*){});
+  struct stat info;
+  if (stat(source.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+  {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, source.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+    {
+      if (fd >= 0) close(fd);
+      return nullptr;
+    }
+    return std::make_shared<FdInputStream>(fd);
+  }
+  shared_ptr<std::ifstream> file_in = std::make_shared<std::ifstream>(source);
+  if (not *file_in) return nullptr;
+  return file_in;
+}
+
+shared_ptr<Thread> readin_stream_thread(vector<string> record, std::map<int, shared_ptr<Process> >& processes,
+                                        std::map<int, int>& next_thread_ids)
+{
+  /**
+   * Parses a streamed thread record:
+   *   arrival_time process_id process_type cpu_time [io_time cpu_time]...
+   * Processes are created on first sight, threads are numbered in arrival order per process.
+   *
+   * Returns pointer to thread object.
+   */
+  SimTime thread_arrival_time = parse_time(record[0]);
+  int proc_id = std::stoi(record[1]);
+  shared_ptr<Process> process = processes[proc_id];
+  if (not process)
+  {
+    Process::Type proc_type = static_cast<Process::Type>(std::stoi(record[2]));
+    process = std::make_shared<Process>(proc_id, proc_type);
+    processes[proc_id] = process;
+  }
+  shared_ptr<Thread> thread = std::make_shared<Thread>(thread_arrival_time, next_thread_ids[proc_id]++, process);
+  for (int i = 3; i < record.size(); i += 2)
+  {
+    SimTime cpu_time = parse_time(record[i]);
+    SimTime io_time = (i + 1 < record.size()) ? parse_time(record[i + 1]) : 0;
+    thread->bursts.push_back(std::make_shared<Burst>(cpu_time, io_time, thread));
+  }
+  return thread;
+}
+
+void run_stream(std::istream& input_stream, Simulation& simulation, SimTime window_size)
+{
+  /**
+   * Streaming main loop. Each record's arrival time is the watermark: all
+   * events before it are processed as soon as the record is read. A line
+   * "W time" advances the watermark without adding a thread. Completed
+   * threads are not kept, so memory is bounded by the live threads.
+   */
+  std::map<int, shared_ptr<Process> > processes;
+  std::map<int, int> next_thread_ids;
+  SimTime watermark = 0;
+  simulation.start_stream(window_size);
+  string line;
+  while (getline(input_stream, line))
+  {
+    vector<string> record = tokenize(line);
+    if (record.empty()) continue; // Skip blank lines
+    if (record.size() < ((record[0] == "W") ? 2 : 4))
+    {
+      std::cout << "ERROR INVALID RECORD: " << line << "\n";
+      continue;
+    }
+    SimTime time = (record[0] == "W") ? parse_time(record[1]) : parse_time(record[0]);
+    if (time < watermark)
+    {
+      std::cout << "ERROR OUT OF ORDER RECORD: " << line << "\n";
+      continue;
+    }
+    watermark = time;
+    if (record[0] != "W")
+    {
+      simulation.add_thread(readin_stream_thread(record, processes, next_thread_ids));
+    }
+    simulation.run_until(watermark);
+  }
+  simulation.finish_stream();
+}
+
 int main(int argc, char *argv[])
 {
    /**
@@ -134,14 +388,40 @@ int main(int argc, char *argv[])
    */
   bool t_flag = false; bool v_flag = false;
   bool a_flag = false; bool h_flag = false;
+  bool m_flag = false; bool s_flag = false;
+  bool r_flag = false; bool i_flag = false;
+  bool q_flag = false;
   // Process command line arguments
-  int opt; int index; string algorithm;
-  const char* const short_opts = "htva:";
+  int opt; int index; string algorithm; SimTime max_age;
+  string stream_source; SimTime window_size = 100;
+  string export_threads_file; string timeline_file;
+  SimTime affinity_window = 0; string import_overheads;
+  vector<string> device_specs; int num_cpus = 1; string warmup_spec;
+  bool g_flag = false; string group_by = "process_type"; string histogram_spec; string analyze_file_path;
+  int num_replicas; unsigned long seed = 1; int perturb_mode = Replication::JITTER;
+  const char* const short_opts = "htvqa:m:s:w:r:S:p:x:l:A:W:i:d:c:g:H:y:";
   const struct option long_opts[] = 
   {
     {"per_thread", no_argument, 0, 't'},
     {"verbose", no_argument, 0, 'v'},
+    {"fast_queue", no_argument, 0, 'q'},
     {"algorithm", required_argument, 0, 'a'},
+    {"max_age", required_argument, 0, 'm'},
+    {"stream", required_argument, 0, 's'},
+    {"window", required_argument, 0, 'w'},
+    {"replicate", required_argument, 0, 'r'},
+    {"seed", required_argument, 0, 'S'},
+    {"perturb", required_argument, 0, 'p'},
+    {"export_threads", required_argument, 0, 'x'},
+    {"timeline", required_argument, 0, 'l'},
+    {"affinity", required_argument, 0, 'A'},
+    {"warmup", required_argument, 0, 'W'},
+    {"import", required_argument, 0, 'i'},
+    {"device", required_argument, 0, 'd'},
+    {"cpus", required_argument, 0, 'c'},
+    {"group_by", required_argument, 0, 'g'},
+    {"histogram", required_argument, 0, 'H'},
+    {"analyze", required_argument, 0, 'y'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -162,48 +442,218 @@ int main(int argc, char *argv[])
       case 'v':
         v_flag = true;
         break;
+      case 'q':
+        q_flag = true;
+        break;
       case 'a':
         a_flag = true;
         algorithm = string(optarg);
         break;
+      case 'm':
+        m_flag = true;
+        max_age = parse_time(optarg);
+        break;
+      case 's':
+        s_flag = true;
+        stream_source = string(optarg);
+        break;
+      case 'w':
+        window_size = parse_time(optarg);
+        if (window_size <= 0)
+        {
+          std::cout << "ERROR INVALID WINDOW " << optarg << "\n";
+          exit(0);
+        }
+        break;
+      case 'r':
+        r_flag = true;
+        num_replicas = std::stoi(optarg);
+        if (num_replicas < 2)
+        {
+          // A confidence interval needs at least two samples
+          std::cout << "ERROR INVALID REPLICA COUNT " << optarg << ", NEEDS AT LEAST 2" << "\n";
+          exit(0);
+        }
+        break;
+      case 'S':
+        seed = std::stoul(optarg);
+        break;
+      case 'p':
+        if (string(optarg) == "resample") perturb_mode = Replication::RESAMPLE;
+        else if (string(optarg) == "bootstrap") perturb_mode = Replication::BOOTSTRAP;
+        else perturb_mode = Replication::JITTER;
+        break;
+      case 'x':
+        export_threads_file = string(optarg);
+        break;
+      case 'l':
+        timeline_file = string(optarg);
+        break;
+      case 'A':
+        affinity_window = parse_time(optarg);
+        break;
+      case 'W':
+        warmup_spec = string(optarg);
+        break;
+      case 'i':
+        i_flag = true;
+        import_overheads = string(optarg);
+        break;
+      case 'd':
+        device_specs.push_back(string(optarg));
+        break;
+      case 'c':
+        num_cpus = std::stoi(optarg);
+        break;
+      case 'g':
+        g_flag = true;
+        group_by = string(optarg);
+        break;
+      case 'H':
+        histogram_spec = string(optarg);
+        break;
+      case 'y':
+        analyze_file_path = string(optarg);
+        break;
       default:
         std::cout << "ERROR INVALID OPTION" << "\n";
         exit(0);
     }
   }
-  // Open input file
-  char* file = argv[optind];
-  std::ifstream file_in(file);
-  if (!file_in) {
-    std::cout << "ERROR INVALID INPUT FILE" << "\n";
+  if (num_cpus > 1 && (s_flag || r_flag || not device_specs.empty()))
+  {
+    // Cores only interact at process placement, streams, replicas and shared devices are not partitioned
+    std::cout << "ERROR --cpus CANNOT BE COMBINED WITH --stream, --replicate OR --device" << "\n";
     exit(0);
   }
+  if (num_cpus > 1 && (v_flag || t_flag || not timeline_file.empty()))
+  {
+    // Cores run concurrently, their event and per-thread output would interleave
+    std::cout << "ERROR --cpus CANNOT BE COMBINED WITH --verbose, --per_thread OR --timeline" << "\n";
+    exit(0);
+  }
+  // Post-run analytics
+  bool analyze = g_flag || not histogram_spec.empty() || not analyze_file_path.empty();
+  shared_ptr<ThreadAnalytics> analytics;
+  if (analyze)
+  {
+    analytics = make_analytics(group_by, histogram_spec);
+    if (not analytics) exit(0);
+    if (not analyze_file_path.empty())
+    {
+      if (analyze_file(analyze_file_path, *analytics)) analytics->output();
+      return 0;
+    }
+    if (s_flag || r_flag)
+    {
+      std::cout << "ERROR --group_by AND --histogram CANNOT BE COMBINED WITH --stream OR --replicate" << "\n";
+      exit(0);
+    }
+  }
+  // Open input file, or the stream source in streaming mode. Traces are read by the importer.
+  shared_ptr<std::istream> input;
+  if (not i_flag)
+  {
+    input = s_flag ? open_stream_source(stream_source)
+                   : open_stream_source(argv[optind] ? argv[optind] : "");
+    if (!input) {
+      std::cout << "ERROR INVALID INPUT FILE" << "\n";
+      exit(0);
+    }
+  }
   // Read in top line parameters:
   // num_processes, thread_switch_overhead, process_switch_overhead
+  // (streams start with thread_switch_overhead, process_switch_overhead,
+  // for traces they are given as -i T:P)
   string top_line;
-  getline(file_in, top_line);
+  if (i_flag) top_line = import_overheads;
+  else getline(*input, top_line);
+  std::replace(top_line.begin(), top_line.end(), ':', ' ');
   vector<string> params = tokenize(top_line);
+  if (s_flag || i_flag) params.insert(params.begin(), "0");
+  if (params.size() < 3) {
+    std::cout << "ERROR INVALID OVERHEADS" << "\n";
+    exit(0);
+  }
   int num_processes = std::stoi(params[0]);
-  int thread_switch_overhead = std::stoi(params[1]);
-  int process_switch_overhead = std::stoi(params[2]);
+  SimTime thread_switch_overhead = parse_time(params[1]);
+  SimTime process_switch_overhead = parse_time(params[2]);
   // Process input file to generate simulation
   string line; 
   int processes_created = 0;
+  vector<shared_ptr<Process> > processes;
   Simulation simulation(process_switch_overhead, thread_switch_overhead);
+  if (q_flag) simulation.set_fast_queue(true);
   if (v_flag) simulation.v_flag = true;
   if (t_flag) simulation.t_flag = true;
   if (a_flag) set_simulation_alg(algorithm, simulation);
+  if (m_flag) simulation.max_age = max_age;
+  simulation.export_threads_file = export_threads_file;
+  simulation.timeline_file = timeline_file;
+  simulation.affinity_window = affinity_window;
+  if (not warmup_spec.empty())
+  {
+    simulation.warmup_model = make_warmup_model(warmup_spec);
+    if (not simulation.warmup_model)
+    {
+      std::cout << "ERROR INVALID WARMUP MODEL " << warmup_spec << "\n";
+      exit(0);
+    }
+  }
+  for (int i = 0; i < device_specs.size(); i++)
+  {
+    if (not add_device(device_specs[i], simulation))
+    {
+      std::cout << "ERROR INVALID DEVICE " << device_specs[i] << "\n";
+      exit(0);
+    }
+  }
+  if (s_flag)
+  {
+    run_stream(*input, simulation, window_size);
+    return 0;
+  }
+  if (i_flag)
+  {
+    processes = import_sched_trace(argv[optind] ? argv[optind] : "");
+    if (processes.empty()) exit(0);
+    if (not r_flag && num_cpus <= 1) for (int i = 0; i < processes.size(); i++) simulation.add_process(processes[i]);
+  }
   for ( int i = 0; i < num_processes; ) // Note no incrementing in for loop expression
   {
-    getline(file_in, line);
+    getline(*input, line);
     if (line.empty())  continue;  // For skipping blank lines
     else
     {
-      simulation.add_process(readin_process(file_in, tokenize(line)));
+      shared_ptr<Process> process = readin_process(*input, tokenize(line));
+      if (r_flag || num_cpus > 1) processes.push_back(process); // Replicas and cores simulate their own
+      else simulation.add_process(process);
       i++; // Onle increment when a process is read in
     }
   }
+  if (num_cpus > 1)
+  {
+    MultiCore(simulation, processes, num_cpus).run(std::thread::hardware_concurrency());
+    if (analytics)
+    {
+      std::cout << "\n";
+      analyze_processes(processes, *analytics);
+      analytics->output();
+    }
+    return 0;
+  }
+  if (r_flag)
+  {
+    Replication(simulation, processes).run(num_replicas, seed, perturb_mode);
+    return 0;
+  }
   // Launch simulation
   simulation.run_simulation();
+  if (analytics)
+  {
+    std::cout << "\n";
+    analyze_processes(simulation.get_processes(), *analytics);
+    analytics->output();
+  }
   return 0;
 }
@@ -0,0 +1,244 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * multicore.cpp
+ * Implimentation of multi-core simulation.
+ *
+ * A process is pinned to a core when its first thread arrives, so the only
+ * interaction between cores is that placement, which looks at every core's
+ * load at the arrival time. Between placements the cores are independent:
+ * each worker advances its cores to the next placement time, then all
+ * workers meet and the main thread places the process. Placements only
+ * depend on simulated time, so results are the same for any number of
+ * workers, including one.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include "process_structs.h"
+#include "simulation.h"
+#include "thread_export.h"
+#include "multicore.h"
+
+using std::cout;
+using std::shared_ptr;
+
+MultiCore::MultiCore(Simulation const & prototype, std::vector<shared_ptr<Process> > processes_arg, int num_cores)
+  : processes(processes_arg), core_processes(num_cores), core_threads(num_cores),
+    export_threads_file(prototype.export_threads_file), warmup_model(prototype.warmup_model != nullptr),
+    max_response(prototype.algorithm == Simulation::CUSTOM)
+{
+  // main rejects -v, -t and -l with --cpus, cores run concurrently
+  assert(not prototype.v_flag && not prototype.t_flag && prototype.timeline_file.empty());
+  for (int i = 0; i < num_cores; i++)
+  {
+    cores.push_back(prototype);
+    cores.back().export_threads_file = ""; // Written once for all cores after the run
+  }
+}
+
+void MultiCore::run(int num_workers)
+{
+  /**
+   * Simulate all cores to completion with num_workers host threads and
+   * output the per-core and combined results.
+   */
+  if (num_workers < 1) num_workers = 1;
+  if (num_workers > cores.size()) num_workers = cores.size();
+  // Processes in order of their first arrival, ties in input order
+  std::vector<std::pair<SimTime, int> > arrivals;
+  for (int i = 0; i < processes.size(); i++)
+  {
+    if (processes[i]->threads.empty()) continue;
+    SimTime first_arrival = processes[i]->threads[0]->arrival_time;
+    for (auto thr = processes[i]->threads.begin(); thr != processes[i]->threads.end(); thr++)
+    {
+      first_arrival = std::min(first_arrival, (*thr)->arrival_time);
+    }
+    arrivals.push_back(std::make_pair(first_arrival, i));
+  }
+  std::stable_sort(arrivals.begin(), arrivals.end(),
+    [](std::pair<SimTime, int> const & a, std::pair<SimTime, int> const & b) { return a.first < b.first; });
+  for (auto core = cores.begin(); core != cores.end(); core++) core->start_simulation();
+  // Worker w owns cores w, w + num_workers, ... and advances them to target each round
+  std::mutex mutex;
+  std::condition_variable work_ready, work_done;
+  long long round = 0;
+  int busy_workers = 0;
+  bool stop = false;
+  SimTime target = 0;
+  std::vector<std::thread> workers;
+  for (int w = 0; w < num_workers; w++)
+  {
+    workers.push_back(std::thread([&, w]() {
+      long long seen_round = 0;
+      while (true)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_ready.wait(lock, [&]() { return round != seen_round; });
+        seen_round = round;
+        if (stop) return;
+        SimTime time_limit = target;
+        lock.unlock();
+        for (int c = w; c < cores.size(); c += num_workers) cores[c].run_until(time_limit);
+        lock.lock();
+        if (--busy_workers == 0) work_done.notify_one();
+      }
+    }));
+  }
+  auto advance = [&](SimTime time_limit) {
+    std::unique_lock<std::mutex> lock(mutex);
+    target = time_limit;
+    busy_workers = num_workers;
+    round++;
+    work_ready.notify_all();
+    work_done.wait(lock, [&]() { return busy_workers == 0; });
+  };
+  SimTime synced_time = -1;
+  for (auto arrival = arrivals.begin(); arrival != arrivals.end(); arrival++)
+  {
+    if (arrival->first > synced_time)
+    {
+      advance(arrival->first);
+      synced_time = arrival->first;
+    }
+    place_process(processes[arrival->second]);
+  }
+  advance(Simulation::END_OF_TIME);
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stop = true;
+    round++;
+    work_ready.notify_all();
+  }
+  for (auto it = workers.begin(); it != workers.end(); it++) it->join();
+  std::vector<SimulationResults> results;
+  for (auto core = cores.begin(); core != cores.end(); core++) results.push_back(core->finish_simulation());
+  if (not export_threads_file.empty()) export_threads(processes, export_threads_file);
+  output(results);
+}
+
+int MultiCore::place_process(shared_ptr<Process> process)
+{
+  /**
+   * Pin process to the core with the fewest live threads, placed there and
+   * not yet completed, lowest index on ties. Every core has processed all
+   * events before the arrival time. Threads count as soon as they are placed,
+   * so processes arriving at the same time spread over the cores.
+   *
+   * Returns the chosen core.
+   */
+  int best = 0;
+  for (int c = 1; c < cores.size(); c++)
+  {
+    if (cores[c].num_live_threads() < cores[best].num_live_threads()) best = c;
+  }
+  int load = cores[best].num_live_threads();
+  cores[best].add_process(process);
+  // The next placement at this time must see this process's threads as load
+  assert(cores[best].num_live_threads() == load + (int) process->threads.size());
+  core_processes[best]++;
+  core_threads[best] += process->threads.size();
+  return best;
+}
+
+void MultiCore::output(std::vector<SimulationResults> const & results)
+{
+  /**
+   * Output every core's totals, then process type data and totals over all
+   * cores. Combined idle time counts each core as idle from its last thread
+   * to the end of the slowest core.
+   */
+  int num_cores = results.size();
+  cout << "MULTI-CORE SIMULATION COMPLETED!\n\n";
+  SimTime elapsed_time = 0, service_time = 0, io_time = 0, dispatch_time = 0, warmup_time = 0;
+  std::vector<std::vector<SimTime> > process_type_data(4, std::vector<SimTime>(4));
+  for (int c = 0; c < num_cores; c++)
+  {
+    SimulationResults const & core = results[c];
+    cout << "CORE " << c << " [" << core_processes[c] << " process(es), " << core_threads[c] << " thread(s)]:\n";
+    cout << std::left << std::setw(24) << "    Elapsed time:";
+    cout << std::right << std::setw(9) << core.elapsed_time << "\n";
+    cout << std::left << std::setw(24) << "    Service time:";
+    cout << std::right << std::setw(9) << core.service_time << "\n";
+    cout << std::left << std::setw(24) << "    Dispatch time:";
+    cout << std::right << std::setw(9) << core.dispatch_time << "\n";
+    if (warmup_model)
+    {
+      cout << std::left << std::setw(24) << "    Warm-up time:";
+      cout << std::right << std::setw(9) << core.warmup_time << "\n";
+    }
+    cout << std::left << std::setw(24) << "    CPU utilization:";
+    cout << std::right << std::setw(8) << std::setprecision(2) << std::fixed
+         << ((core.elapsed_time == 0) ? 0 : core.cpu_utilization) << "%\n";
+    cout << "\n";
+    elapsed_time = std::max(elapsed_time, core.elapsed_time);
+    service_time = time_add(service_time, core.service_time);
+    io_time = time_add(io_time, core.io_time);
+    dispatch_time = time_add(dispatch_time, core.dispatch_time);
+    warmup_time = time_add(warmup_time, core.warmup_time);
+    for (int type = 0; type <= 3; type++)
+    {
+      process_type_data[type][0] += core.process_type_data[type][0];
+      process_type_data[type][1] = time_add(process_type_data[type][1], core.process_type_data[type][1]);
+      process_type_data[type][2] = time_add(process_type_data[type][2], core.process_type_data[type][2]);
+      process_type_data[type][3] = std::max(process_type_data[type][3], core.process_type_data[type][3]);
+    }
+  }
+  for (int type = 0; type <= 3; type++)
+  {
+    double thr_count = (double) process_type_data[type][0];
+    double average_response_time = (thr_count == 0) ? 0 : process_type_data[type][1] / thr_count;
+    double average_turnaround_time = (thr_count == 0) ? 0 : process_type_data[type][2] / thr_count;
+    cout << Simulation::process_type_string(type) << " THREADS:\n";
+    cout << std::left << std::setw(24) << "    Total count:";
+    cout << std::right << std::setw(9) << process_type_data[type][0] << "\n";
+    cout << std::left << std::setw(24) << "    Avg response time:";
+    cout << std::right << std::setw(9) << std::setprecision(2) << std::fixed << average_response_time << "\n";
+    if (max_response)
+    {
+      cout << std::left << std::setw(24) << "    Max response time:";
+      cout << std::right << std::setw(9) << process_type_data[type][3] << "\n";
+    }
+    cout << std::left << std::setw(24) << "    Avg turnaround time:";
+    cout << std::right << std::setw(9) << std::setprecision(2) << std::fixed << average_turnaround_time << "\n";
+    cout << "\n";
+  }
+  double capacity = (double) num_cores * elapsed_time;
+  SimTime idle_time = num_cores * elapsed_time - service_time - dispatch_time - warmup_time;
+  cout << std::left << std::setw(24) << "Cores:";
+  cout << std::right << std::setw(9) << num_cores << "\n";
+  cout << std::left << std::setw(24) << "Total elapsed time:";
+  cout << std::right << std::setw(9) << elapsed_time << "\n";
+  cout << std::left << std::setw(24) << "Total service time:";
+  cout << std::right << std::setw(9) << service_time << "\n";
+  cout << std::left << std::setw(24) << "Total I/O time:";
+  cout << std::right << std::setw(9) << io_time << "\n";
+  cout << std::left << std::setw(24) << "Total dispatch time:";
+  cout << std::right << std::setw(9) << dispatch_time << "\n";
+  if (warmup_model)
+  {
+    cout << std::left << std::setw(24) << "Total warm-up time:";
+    cout << std::right << std::setw(9) << warmup_time << "\n";
+  }
+  cout << std::left << std::setw(24) << "Total idle time:";
+  cout << std::right << std::setw(9) << idle_time << "\n";
+  cout << "\n";
+  cout << std::left << std::setw(24) << "CPU utilization:";
+  cout << std::right << std::setw(8) << std::setprecision(2) << std::fixed
+       << ((capacity == 0) ? 0 : 100 * (capacity - idle_time) / capacity) << "%\n";
+  cout << std::left << std::setw(24) << "CPU efficiency:";
+  cout << std::right << std::setw(8) << std::setprecision(2) << std::fixed
+       << ((capacity == 0) ? 0 : 100 * service_time / capacity) << "%\n";
+}
@@ -0,0 +1,39 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * multicore.h
+ *
+ * Defines multi-core simulation. Every core is its own Simulation with its
+ * own event queue and ready queues, and processes are placed on the least
+ * loaded core when their first thread arrives. Cores run in parallel on host
+ * threads and only synchronize at those placements.
+ */
+
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include "process_structs.h"
+#include "simulation.h"
+
+struct MultiCore
+{
+  MultiCore(Simulation const & prototype, std::vector<std::shared_ptr<Process> > processes_arg, int num_cores);
+  void run(int num_workers);
+private:
+  int place_process(std::shared_ptr<Process> process);
+  void output(std::vector<SimulationResults> const & results);
+  std::vector<std::shared_ptr<Process> > processes;
+  std::vector<Simulation> cores;
+  std::vector<int> core_processes; // Processes placed on each core
+  std::vector<int> core_threads;   // Threads placed on each core
+  std::string export_threads_file;
+  bool warmup_model; // Report warm-up time
+  bool max_response; // Report max response times (CUSTOM only)
+};
+
+#endif
@@ -12,10 +12,36 @@
 #define PROCESS_STRUCTS_H
 
 #include <vector>
+#include <list>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <iostream>
+#include <cstdlib>
 
-struct Process; struct Thread; struct Burst; struct Event;
+// Simulation time and time accumulators. 64-bit unless built with COMPACT_TIME
+// (make COMPACT_TIME=1), which halves the size of every time field for small traces.
+#ifdef COMPACT_TIME
+typedef int32_t SimTime;
+#else
+typedef int64_t SimTime;
+#endif
+
+inline SimTime time_add(SimTime a, SimTime b)
+{
+  /**
+   * Overflow checked addition for times and time accumulators.
+   */
+  SimTime sum;
+  if (__builtin_add_overflow(a, b, &sum))
+  {
+    std::cerr << "ERROR TIME OVERFLOW (" << a << " + " << b << "), rebuild without COMPACT_TIME\n";
+    exit(1);
+  }
+  return sum;
+}
+
+struct Process; struct Thread; struct Burst; struct Event; struct ReadyQueue;
 
 struct Process
 {
@@ -23,50 +49,65 @@ struct Process
     SYSTEM = 0, INTERACTIVE = 1, NORMAL = 2, BATCH = 3
   };
   Process(int proc_id, Type proc_type) 
-    : id(proc_id), type(proc_type) 
+    : id(proc_id), type(proc_type), last_run_end(-1)
   {}
   int id;
   Type type;
+  SimTime last_run_end; // Last time any of its threads left the CPU, -1 if none has run
   std::vector<std::shared_ptr<Thread> > threads;
 };
 
 struct Thread
 {
-  Thread(int arr_time_arg, int thr_id_arg, std::shared_ptr<Process> proc_arg)
+  Thread(SimTime arr_time_arg, int thr_id_arg, std::shared_ptr<Process> proc_arg)
     : id(thr_id_arg), state("NEW"), process(proc_arg), start_time(-1), arrival_time(arr_time_arg), 
-      end_time(0), burst_index(0), current_burst_completed_time(0), arrive_time(0)
+      end_time(0), burst_index(0), current_burst_completed_time(0), arrive_time(0), ready_time(0),
+      last_run_end(-1), total_cpu_time(0), total_io_time(0), ready_wait_time(0), ready_queue(nullptr)
   {}
   int id;
   std::string state;
   std::shared_ptr<Process> process;
-  int start_time;
-  int arrival_time;
-  int end_time;
+  SimTime start_time;
+  SimTime arrival_time;
+  SimTime end_time;
   int burst_index;
-  int current_burst_completed_time;
-  int arrive_time;
+  SimTime current_burst_completed_time;
+  SimTime arrive_time;
+  SimTime ready_time; // Time the thread last entered the ready queue
+  SimTime last_run_end; // Time the thread last left the CPU, -1 if it has not run
+  // Totals accumulated while simulating
+  SimTime total_cpu_time;
+  SimTime total_io_time;
+  SimTime ready_wait_time;
+  // Where the thread sits while READY, so it can be taken out of order
+  ReadyQueue* ready_queue;
+  std::list<std::shared_ptr<Thread> >::iterator ready_position;
+  std::list<std::shared_ptr<Thread> >::iterator process_ready_position;
   std::vector<std::shared_ptr<Burst> > bursts;
 };
 
 struct Burst
 {
-  Burst(int cpu_time_arg, int io_time_arg, std::shared_ptr<Thread> thr_arg)
-    : cpu_time(cpu_time_arg), io_time(io_time_arg), thread(thr_arg)
+  Burst(SimTime cpu_time_arg, SimTime io_time_arg, std::shared_ptr<Thread> thr_arg)
+    : cpu_time(cpu_time_arg), io_time(io_time_arg), device(-1), position(0), thread(thr_arg)
   {}
-  int cpu_time;
-  int io_time;
-  std::shared_ptr<Thread> thread;
+  SimTime cpu_time;
+  SimTime io_time;
+  int device;        // IO device the burst's IO goes to, -1 for none (no contention)
+  SimTime position;  // Position on the device, for elevator ordering
+  std::weak_ptr<Thread> thread; // Weak, the thread owns its bursts
 };
 
 struct Event
 {
-  Event() : time(0), type(0)
+  Event() : time(0), type(0), seq(0)
   {}
-  Event(int time_arg, int type_arg)
-    : time(time_arg), type(type_arg)
+  Event(SimTime time_arg, int type_arg)
+    : time(time_arg), type(type_arg), seq(0)
   {}
-  int time;
+  SimTime time;
   int type;
+  long long seq; // Set by EventQueue, breaks remaining ties in insertion order
   std::shared_ptr<Thread> thread;
   std::shared_ptr<Burst> burst;
   // Event types
@@ -0,0 +1,218 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * replication.cpp
+ * Implimentation of Monte Carlo replication. Replicas are handed out to one
+ * worker per core, each replica seeds its own RNG from (seed, replica) so the
+ * results do not depend on which worker ran it or in what order.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+#include "process_structs.h"
+#include "simulation.h"
+#include "replication.h"
+
+using std::cout;
+using std::shared_ptr;
+
+Replication::Replication(Simulation const & prototype_arg, std::vector<shared_ptr<Process> > processes_arg)
+  : prototype(prototype_arg), processes(processes_arg), arrival_jitter(1), cpu_times(4), io_times(4)
+{
+  // Gather the workload statistics the perturbations draw from
+  int num_threads = 0; SimTime first_arrival = -1; SimTime last_arrival = 0;
+  for (auto proc = processes.begin(); proc != processes.end(); proc++)
+  {
+    for (auto thr = (*proc)->threads.begin(); thr != (*proc)->threads.end(); thr++)
+    {
+      num_threads++;
+      if (first_arrival == -1 || (*thr)->arrival_time < first_arrival) first_arrival = (*thr)->arrival_time;
+      if ((*thr)->arrival_time > last_arrival) last_arrival = (*thr)->arrival_time;
+      for (auto burst = (*thr)->bursts.begin(); burst != (*thr)->bursts.end(); burst++)
+      {
+        cpu_times[(*proc)->type].push_back((*burst)->cpu_time);
+        if ((*burst)->io_time != 0) io_times[(*proc)->type].push_back((*burst)->io_time);
+      }
+    }
+  }
+  // Arrivals move by up to one mean interarrival gap
+  if (num_threads != 0 && (last_arrival - first_arrival) / num_threads > 1)
+  {
+    arrival_jitter = (last_arrival - first_arrival) / num_threads;
+  }
+}
+
+void Replication::run(int num_replicas, unsigned long seed, int perturb_mode)
+{
+  /**
+   * Run num_replicas perturbed replicas over all cores and output the mean
+   * and 95% confidence interval of every total.
+   */
+  assert(num_replicas >= 2); // The CI needs at least two samples
+  std::vector<SimulationResults> results(num_replicas);
+  std::atomic<int> next_replica(0);
+  int num_workers = std::thread::hardware_concurrency();
+  if (num_workers < 1) num_workers = 1;
+  if (num_workers > num_replicas) num_workers = num_replicas;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_workers; i++)
+  {
+    workers.push_back(std::thread([&]() {
+      for (int replica = next_replica++; replica < num_replicas; replica = next_replica++)
+      {
+        results[replica] = run_replica(replica, seed, perturb_mode);
+      }
+    }));
+  }
+  for (auto it = workers.begin(); it != workers.end(); it++) it->join();
+  // Output
+  std::string modes[] = {"jitter", "resample", "bootstrap"};
+  cout << "REPLICATION COMPLETED!\n\n";
+  cout << num_replicas << " replicas, seed " << seed << ", perturbation: " << modes[perturb_mode] << "\n\n";
+  cout << std::left << std::setw(24) << "" << std::right << std::setw(12) << "mean";
+  cout << std::setw(26) << "95% CI" << "\n";
+  std::vector<double> elapsed, service, io, dispatch, warmup, idle, utilization, efficiency;
+  for (auto it = results.begin(); it != results.end(); it++)
+  {
+    elapsed.push_back(it->elapsed_time);
+    service.push_back(it->service_time);
+    io.push_back(it->io_time);
+    dispatch.push_back(it->dispatch_time);
+    warmup.push_back(it->warmup_time);
+    idle.push_back(it->idle_time);
+    utilization.push_back(it->cpu_utilization);
+    efficiency.push_back(it->cpu_efficiency);
+  }
+  output_metric("Total elapsed time:", elapsed);
+  output_metric("Total service time:", service);
+  output_metric("Total I/O time:", io);
+  output_metric("Total dispatch time:", dispatch);
+  if (prototype.warmup_model) output_metric("Total warm-up time:", warmup);
+  output_metric("Total idle time:", idle);
+  cout << "\n";
+  output_metric("CPU utilization (%):", utilization);
+  output_metric("CPU efficiency (%):", efficiency);
+}
+
+SimulationResults Replication::run_replica(int replica, unsigned long seed, int perturb_mode)
+{
+  /**
+   * Simulate one perturbed copy of the workload.
+   *
+   * Returns the replica's final simulation data.
+   */
+  std::seed_seq seeds{(unsigned long) (seed & 0xffffffff), (unsigned long) (seed >> 32), (unsigned long) replica};
+  std::mt19937_64 rng(seeds);
+  Simulation simulation = prototype;
+  simulation.v_flag = false;
+  simulation.t_flag = false;
+  simulation.timeline_file = ""; // Replicas run concurrently, none of them write files
+  std::vector<shared_ptr<Process> > workload = perturb(perturb_mode, rng);
+  for (auto it = workload.begin(); it != workload.end(); it++) simulation.add_process(*it);
+  SimulationResults results = simulation.simulate();
+  // Break the process/thread/burst reference cycles so the copy is freed
+  for (auto proc = workload.begin(); proc != workload.end(); proc++)
+  {
+    for (auto thr = (*proc)->threads.begin(); thr != (*proc)->threads.end(); thr++) (*thr)->bursts.clear();
+    (*proc)->threads.clear();
+  }
+  return results;
+}
+
+std::vector<shared_ptr<Process> > Replication::perturb(int perturb_mode, std::mt19937_64& rng)
+{
+  /**
+   * Build a perturbed deep copy of the workload:
+   *   JITTER: every arrival moves by up to one mean interarrival gap.
+   *   RESAMPLE: every burst length is redrawn from all bursts of its process type.
+   *   BOOTSTRAP: every process's threads are resampled with replacement.
+   *
+   * Returns the new list of processes.
+   */
+  std::vector<shared_ptr<Process> > workload;
+  std::uniform_int_distribution<SimTime> jitter(-arrival_jitter, arrival_jitter);
+  for (auto proc = processes.begin(); proc != processes.end(); proc++)
+  {
+    shared_ptr<Process> process = std::make_shared<Process>((*proc)->id, (*proc)->type);
+    int num_threads = (*proc)->threads.size();
+    std::uniform_int_distribution<int> pick_thread(0, num_threads - 1);
+    for (int i = 0; i < num_threads; i++)
+    {
+      shared_ptr<Thread> source = (perturb_mode == BOOTSTRAP) ? (*proc)->threads[pick_thread(rng)] : (*proc)->threads[i];
+      shared_ptr<Thread> thread = clone_thread(source, process, i);
+      if (perturb_mode == JITTER)
+      {
+        thread->arrival_time += jitter(rng);
+        if (thread->arrival_time < 0) thread->arrival_time = 0;
+      }
+      else if (perturb_mode == RESAMPLE)
+      {
+        std::vector<SimTime>& cpu_pool = cpu_times[process->type];
+        std::vector<SimTime>& io_pool = io_times[process->type];
+        std::uniform_int_distribution<int> pick_cpu(0, cpu_pool.size() - 1);
+        std::uniform_int_distribution<int> pick_io(0, io_pool.empty() ? 0 : io_pool.size() - 1);
+        for (auto burst = thread->bursts.begin(); burst != thread->bursts.end(); burst++)
+        {
+          (*burst)->cpu_time = cpu_pool[pick_cpu(rng)];
+          if ((*burst)->io_time != 0) (*burst)->io_time = io_pool[pick_io(rng)]; // Last burst stays without I/O
+        }
+      }
+      process->threads.push_back(thread);
+    }
+    workload.push_back(process);
+  }
+  return workload;
+}
+
+shared_ptr<Thread> Replication::clone_thread(shared_ptr<Thread> source, shared_ptr<Process> process, int thread_id)
+{
+  /**
+   * Returns a fresh (unsimulated) copy of source's arrival time and bursts.
+   */
+  shared_ptr<Thread> thread = std::make_shared<Thread>(source->arrival_time, thread_id, process);
+  for (auto it = source->bursts.begin(); it != source->bursts.end(); it++)
+  {
+    thread->bursts.push_back(std::make_shared<Burst>((*it)->cpu_time, (*it)->io_time, thread));
+  }
+  return thread;
+}
+
+void Replication::output_metric(std::string name, std::vector<double> values)
+{
+  /**
+   * Output mean and 95% confidence interval (Student's t) of values.
+   */
+  // Two-sided 97.5% t quantiles for 1-30 degrees of freedom, normal beyond
+  static const double T_QUANTILES[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+  };
+  int n = values.size();
+  double mean = 0;
+  for (int i = 0; i < n; i++) mean += values[i];
+  mean /= n;
+  double half_width = 0;
+  if (n > 1)
+  {
+    double variance = 0;
+    for (int i = 0; i < n; i++) variance += (values[i] - mean) * (values[i] - mean);
+    variance /= n - 1;
+    double t = (n - 1 <= 30) ? T_QUANTILES[n - 2] : 1.960;
+    half_width = t * std::sqrt(variance / n);
+  }
+  cout << std::left << std::setw(24) << name;
+  cout << std::right << std::setw(12) << std::setprecision(2) << std::fixed << mean;
+  cout << "  [" << std::setw(10) << mean - half_width << ", " << std::setw(10) << mean + half_width << "]\n";
+}
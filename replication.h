@@ -0,0 +1,44 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * replication.h
+ *
+ * Defines Monte Carlo replication: the workload is perturbed and simulated
+ * many times in parallel, and every total is reported with a 95% confidence
+ * interval.
+ */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <random>
+#include "process_structs.h"
+#include "simulation.h"
+
+struct Replication
+{
+  Replication(Simulation const & prototype_arg, std::vector<std::shared_ptr<Process> > processes_arg);
+  void run(int num_replicas, unsigned long seed, int perturb_mode);
+  // Perturbation modes
+  static const int JITTER = 0;
+  static const int RESAMPLE = 1;
+  static const int BOOTSTRAP = 2;
+private:
+  SimulationResults run_replica(int replica, unsigned long seed, int perturb_mode);
+  std::vector<std::shared_ptr<Process> > perturb(int perturb_mode, std::mt19937_64& rng);
+  std::shared_ptr<Thread> clone_thread(std::shared_ptr<Thread> thread, std::shared_ptr<Process> process, int thread_id);
+  void output_metric(std::string name, std::vector<double> values);
+  Simulation const & prototype;
+  std::vector<std::shared_ptr<Process> > processes;
+  // Workload statistics used by the perturbations
+  SimTime arrival_jitter;
+  std::vector<std::vector<SimTime> > cpu_times;
+  std::vector<std::vector<SimTime> > io_times;
+};
+
+#endif
@@ -15,62 +15,142 @@
 #include <iomanip>
 #include <cassert>
 #include <memory>
+#include <algorithm>
 #include "process_structs.h"
 #include "simulation.h"
+#include "window_metrics.h"
+#include "thread_export.h"
+#include "timeline.h"
 
 using std::cout; 
 using std::shared_ptr;
 
-CustomReadyQueue::CustomReadyQueue()
+bool ReadyQueue::empty() const
+{
+  return threads.empty();
+}
+
+size_t ReadyQueue::size() const
+{
+  return threads.size();
+}
+
+shared_ptr<Thread> ReadyQueue::front() const
+{
+  return threads.front();
+}
+
+void ReadyQueue::push(shared_ptr<Thread> thread)
+{
+  /**
+   * Add thread to back of queue, remembering its position so it can be
+   * erased later without a search.
+   */
+  thread->ready_position = threads.insert(threads.end(), thread);
+  thread->ready_queue = this;
+}
+
+void ReadyQueue::pop()
+{
+  threads.front()->ready_queue = nullptr;
+  threads.pop_front();
+}
+
+void ReadyQueue::erase(shared_ptr<Thread> thread)
+{
+  /**
+   * Remove thread from anywhere in the queue in constant time.
+   */
+  assert(thread->ready_queue == this);
+  threads.erase(thread->ready_position);
+  thread->ready_queue = nullptr;
+}
+
+CustomReadyQueue::CustomReadyQueue(SimTime max_age_arg)
   : short_queues(4), long_queues(4), dynamic_quantom(-1), 
-    num_threads(0), total_remaining_time(0), avg_age(-1)
+    num_threads(0), total_remaining_time(0), max_age(max_age_arg)
 {}
 
-shared_ptr<Thread> CustomReadyQueue::fetch_thread()
+void CustomReadyQueue::promote_aged(SimTime current_time)
+{
+   /**
+   * Move threads that have been ready for longer than max_age to the aged queue.
+   * Every short/long queue is FIFO by ready time, so only the fronts need to be
+   * checked: the oldest front is the oldest ready thread overall. Threads are
+   * promoted oldest first, which keeps the aged queue FIFO by ready time too.
+   */
+  if (max_age <= 0) return; // Aging disabled
+  while (true)
+  {
+    ReadyQueue* oldest = nullptr;
+    for(auto it = short_queues.begin(); it!=short_queues.end(); it++)
+    {
+      if (not it->empty() && (oldest == nullptr || it->front()->ready_time < oldest->front()->ready_time)) oldest = &*it;
+    }
+    for(auto it = long_queues.begin(); it!=long_queues.end(); it++)
+    {
+      if (not it->empty() && (oldest == nullptr || it->front()->ready_time < oldest->front()->ready_time)) oldest = &*it;
+    }
+    if (oldest == nullptr || current_time - oldest->front()->ready_time <= max_age) return;
+    shared_ptr<Thread> thread = oldest->front();
+    oldest->pop();
+    aged_queue.push(thread);
+  }
+}
+
+shared_ptr<Thread> CustomReadyQueue::fetch_thread(SimTime current_time)
 {
    /**
-   * Get thread from top of set of ready queues. Checks short queues and then
-   * long queues, both in order of priority, and returns top thread.
-   * 
    * Returns pointer to next thread to be run, pops that thread from ready queue.
    */
-  shared_ptr<Thread> next_thread = nullptr;
+  shared_ptr<Thread> next_thread = front_thread(current_time);
+  assert(next_thread != nullptr); // should only fetch thread when there is a thread to fetch
+  remove_thread(next_thread);
+  return next_thread;
+}
+
+shared_ptr<Thread> CustomReadyQueue::front_thread(SimTime current_time)
+{
+   /**
+   * Get thread from top of set of ready queues. Threads that have aged past
+   * max_age are taken first, then short queues and then long queues, both in
+   * order of priority.
+   * 
+   * Returns pointer to next thread to be run without removing it, nullptr if
+   * no thread is ready.
+   */
+  promote_aged(current_time);
+  if (not aged_queue.empty()) return aged_queue.front();
   for(auto it = short_queues.begin(); it!=short_queues.end(); it++)
   {
     // First check short queues in priority order
-    if(not it->empty())
-    {
-      next_thread = it->front();
-      it->pop();
-      break;
-    }
+    if(not it->empty()) return it->front();
   }
-  if (next_thread == nullptr)
+  for(auto it = long_queues.begin(); it!=long_queues.end(); it++)
   {
-      for(auto it = long_queues.begin(); it!=long_queues.end(); it++)
-    {
     // Then check long queues in priority order
-      if(not it->empty())
-      {
-        next_thread = it->front();
-        it->pop();
-        break;
-      }
-    } 
-  }
-  // adjust metrics
-  assert(next_thread != nullptr); // should only fetch thread when there is a thread to fetch
+    if(not it->empty()) return it->front();
+  }
+  return nullptr;
+}
+
+void CustomReadyQueue::remove_thread(shared_ptr<Thread> next_thread)
+{
+   /**
+   * Remove a ready thread from whichever queue holds it and update the
+   * dynamic quantom for the threads left.
+   */
+  next_thread->ready_queue->erase(next_thread);
   num_threads--;
-  int burst_remaining_time = next_thread->bursts[next_thread->burst_index]->cpu_time 
+  SimTime burst_remaining_time = next_thread->bursts[next_thread->burst_index]->cpu_time 
     - next_thread->current_burst_completed_time;
   total_remaining_time -= burst_remaining_time;
   assert(total_remaining_time==num_threads || num_threads != 0);
   if (num_threads != 0){
     // Update dynamic qunatom if ready queue is not empty
-    int average_remaining_time = total_remaining_time/num_threads;
+    SimTime average_remaining_time = total_remaining_time/num_threads;
     dynamic_quantom = (average_remaining_time < QUANTOM_MAX) ? average_remaining_time : QUANTOM_MAX; ;
   }
-  return next_thread; ;
 }
 
 void CustomReadyQueue::push_thread(shared_ptr<Thread> thread)
@@ -79,12 +159,13 @@ void CustomReadyQueue::push_thread(shared_ptr<Thread> thread)
    * Add thread to ready queues. Determines based on the current dynamic quantom
    * whether to add the thread to short or long queue for a given priority. Threads
    * with remaining CPU burst times <= to the current quantum are added to the
-   * short queues, longer burst times to the long queues.
+   * short queues, longer burst times to the long queues. The thread's
+   * ready_time must already be set, aging is measured from it.
    */
-  int burst_remaining_time = thread->bursts[thread->burst_index]->cpu_time - thread->current_burst_completed_time;
+  SimTime burst_remaining_time = thread->bursts[thread->burst_index]->cpu_time - thread->current_burst_completed_time;
   num_threads++;
-  total_remaining_time += burst_remaining_time;
-  int average_remaining_time = total_remaining_time / num_threads; // this should round down
+  total_remaining_time = time_add(total_remaining_time, burst_remaining_time);
+  SimTime average_remaining_time = total_remaining_time / num_threads; // this should round down
   dynamic_quantom = (average_remaining_time < QUANTOM_MAX) ? average_remaining_time : QUANTOM_MAX; 
   (burst_remaining_time <= dynamic_quantom) ? 
     short_queues[thread->process->type].push(thread)
@@ -92,13 +173,16 @@ void CustomReadyQueue::push_thread(shared_ptr<Thread> thread)
 }
 
 // Constructor for simulation
-Simulation::Simulation(int proc_overhead, int thr_overhead) 
+Simulation::Simulation(SimTime proc_overhead, SimTime thr_overhead) 
   : v_flag(false), t_flag(false), 
     total_elapsed_time(0), total_dispatch_time(0), total_io_time(0), 
-    total_service_time(0), total_idle_time(0), process_type_data(4, std::vector<int>(3)),
+    total_service_time(0), total_idle_time(0), total_warmup_time(0), affinity_dispatches(0), live_threads(0), process_type_data(4, std::vector<SimTime>(4)),
     process_switch_overhead(proc_overhead), thread_switch_overhead(thr_overhead),
-    running_thread(nullptr), quantom(3), algorithm(FCFS), priority_ready_queues(4),
-    current_process_id(-1), custom_ready_queue(nullptr)
+    running_thread(nullptr), quantom(3), algorithm(FCFS), max_age(CustomReadyQueue::DEFAULT_MAX_AGE),
+    affinity_window(0), warmup_model(nullptr),
+    priority_ready_queues(4),
+    current_process_id(-1), custom_ready_queue(nullptr), window_metrics(nullptr),
+    timeline(nullptr), run_start_time(0), fast_queue(false), fast_event_pending(false)
 {}
 
 
@@ -108,6 +192,7 @@ void Simulation::add_process(std::shared_ptr<Process> process)
    * Add process to simulation, also adds thread arrival to event queue.
    */
   processes.push_back(process);
+  live_threads += process->threads.size();
   for (int i=0; i<process->threads.size(); i++){
     Event event(process->threads[i]->arrival_time, Event::THREAD_ARRIVED);
     event.thread = process->threads[i];
@@ -115,17 +200,41 @@ void Simulation::add_process(std::shared_ptr<Process> process)
   }
 }
 
-bool CompareEventsByArrivalTime::operator()(Event const & e1, Event const & e2)
+void Simulation::set_fast_queue(bool enabled)
 {
    /**
-   * Comparator for event priority queue
-   * Sorts by earliest time, then lowest Event::Type number, then highest thread id
+   * Use the timing wheel event queue and the fast path. Must be set before
+   * any process is added. Events that tie on time, type and thread id then run
+   * in the order they were raised rather than the heap's order, which changes
+   * results for some inputs.
    */
-  if (e1.time == e2.time)
-  {
-    return ((e1.type == e2.type) ? e1.thread->id < e2.thread->id : e1.type > e2.type);
-  }
-  else return e1.time > e2.time;
+  fast_queue = enabled;
+  event_queue.set_wheel(enabled);
+}
+
+void Simulation::add_device(int id, int channels, int discipline)
+{
+   /**
+   * Add an IO device, bursts tagged with its id queue for one of its channels.
+   */
+  io_devices.insert(std::make_pair(id, IoDevice(id, channels, discipline)));
+}
+
+std::vector<std::shared_ptr<Process> > Simulation::get_processes()
+{
+  return processes;
+}
+
+void Simulation::add_thread(std::shared_ptr<Thread> thread)
+{
+   /**
+   * Add thread arrival to event queue without keeping the thread in the
+   * process list, used in streaming mode so completed threads are freed.
+   */
+  live_threads++;
+  Event event(thread->arrival_time, Event::THREAD_ARRIVED);
+  event.thread = thread;
+  event_queue.push(event);
 }
 
 bool CompareThreadsByArrivalTime::operator()(std::shared_ptr<Thread> const & t1, std::shared_ptr<Thread> const & t2)
@@ -140,33 +249,164 @@ bool CompareThreadsByArrivalTime::operator()(std::shared_ptr<Thread> const & t1,
 void Simulation::run_simulation()
 {
   /**
-   * Main event loop for simulation.
+   * Run the simulation to completion and output results.
    */
-  // Custom ready queue initialization for CUSTOM algorithm
-  if (algorithm == CUSTOM) custom_ready_queue = std::make_shared<CustomReadyQueue>();
-  // Main event loop
-  while(event_queue.empty() == false)
-  {
-    Event next_event = event_queue.top();
-    event_queue.pop();
-    // Pass to different event handlers
-    if (next_event.type == Event::THREAD_ARRIVED) handle_thread_arrival(next_event);
-    if (next_event.type == Event::DISPATCHER_INVOKED) handle_dispatcher_invoked(next_event);
-    if (next_event.type == Event::PROCESS_DISPATCH_COMPLETED) handle_dispatch_complete(next_event);
-    if (next_event.type == Event::THREAD_DISPATCH_COMPLETED) handle_dispatch_complete(next_event);
-    if (next_event.type == Event::CPU_BURST_COMPLETED) handle_cpu_burst_complete(next_event);
-    if (next_event.type == Event::IO_BURST_COMPLETED) handle_io_burst_complete(next_event);
-    if (next_event.type == Event::THREAD_COMPLETED) handle_thread_complete(next_event);
-    if (next_event.type == Event::THREAD_PREEMPTED) handle_thread_preempted(next_event);
-    ////////////
-  }
+  start_simulation();
+  run_until(END_OF_TIME);
+  timeline.reset(); // Closes the timeline file
   // Result outputs
   if (t_flag) tflag_output();
+  if (not export_threads_file.empty()) export_threads(processes, export_threads_file);
   cout << "SIMULATION COMPLETED!\n\n";
   output_process_type_data();
   output_totals();
 }
 
+SimulationResults Simulation::simulate()
+{
+  /**
+   * Run the simulation to completion without any output.
+   *
+   * Returns final simulation data.
+   */
+  start_simulation();
+  return finish_simulation();
+}
+
+SimulationResults Simulation::finish_simulation()
+{
+  /**
+   * Run a started simulation to completion without any output, processes
+   * may have been added as it ran.
+   *
+   * Returns final simulation data.
+   */
+  run_until(END_OF_TIME);
+  timeline.reset();
+  return get_results();
+}
+
+int Simulation::num_live_threads()
+{
+  /**
+   * Returns number of threads added (arrived or still to arrive) and not yet completed.
+   */
+  return live_threads;
+}
+
+void Simulation::start_stream(SimTime window_size)
+{
+  /**
+   * Start a streaming simulation. Threads are added with add_thread as they
+   * are read and the caller advances the watermark with run_until, metrics
+   * are output every window_size time units.
+   */
+  window_metrics = std::make_shared<WindowMetrics>(window_size);
+  start_simulation();
+}
+
+void Simulation::finish_stream()
+{
+  /**
+   * Drain remaining events at end of stream and output final results.
+   */
+  run_until(END_OF_TIME);
+  timeline.reset();
+  window_metrics->finish(total_elapsed_time);
+  cout << "STREAM COMPLETED!\n\n";
+  output_process_type_data();
+  output_totals();
+}
+
+void Simulation::start_simulation()
+{
+  /**
+   * Set up algorithm specific state before the first event.
+   */
+  // Custom ready queue initialization for CUSTOM algorithm
+  if (algorithm == CUSTOM) custom_ready_queue = std::make_shared<CustomReadyQueue>(max_age);
+  if (not timeline_file.empty()) timeline = open_timeline(timeline_file);
+}
+
+void Simulation::run_until(SimTime time_limit)
+{
+  /**
+   * Main event loop for simulation. Processes every event before time_limit,
+   * no event earlier than time_limit may be added afterwards.
+   */
+  while(true)
+  {
+    Event next_event;
+    if (fast_event_pending)
+    {
+      if (fast_event.time >= time_limit) break;
+      next_event = fast_event;
+      fast_event_pending = false;
+    }
+    else if (event_queue.empty() == false && event_queue.next_time() < time_limit)
+    {
+      next_event = event_queue.top();
+      event_queue.pop();
+    }
+    else break;
+    if (window_metrics) window_metrics->advance(next_event.time);
+    process_event(next_event);
+  }
+  if (fast_event_pending)
+  {
+    // Leave the queue complete for threads added before the next run_until
+    event_queue.push(fast_event);
+    fast_event_pending = false;
+  }
+  if (window_metrics && time_limit != END_OF_TIME) window_metrics->advance(time_limit);
+}
+
+void Simulation::schedule(Event event)
+{
+  /**
+   * Queue an event raised by a handler. An event strictly earlier than every
+   * queued event is held in fast_event instead and run next without going
+   * through the event queue. While a single thread is runnable that is every
+   * event it raises (dispatch, burst end, IO completion, next dispatch), so
+   * its bursts run straight through until the next arrival or other thread's
+   * event is due. A held event is queued before any later one, so events
+   * enter the queue in the same order as without the fast path and ties are
+   * broken the same way. The single heap is kept exactly as it always was, so
+   * without the fast queue every event is pushed.
+   */
+  if (not fast_queue)
+  {
+    event_queue.push(event);
+    return;
+  }
+  if (fast_event_pending)
+  {
+    event_queue.push(fast_event);
+    fast_event_pending = false;
+  }
+  if (event_queue.empty() || event.time < event_queue.next_time())
+  {
+    fast_event = event;
+    fast_event_pending = true;
+  }
+  else event_queue.push(event);
+}
+
+void Simulation::process_event(Event next_event)
+{
+  /**
+   * Pass event to its handler.
+   */
+  if (next_event.type == Event::THREAD_ARRIVED) handle_thread_arrival(next_event);
+  if (next_event.type == Event::DISPATCHER_INVOKED) handle_dispatcher_invoked(next_event);
+  if (next_event.type == Event::PROCESS_DISPATCH_COMPLETED) handle_dispatch_complete(next_event);
+  if (next_event.type == Event::THREAD_DISPATCH_COMPLETED) handle_dispatch_complete(next_event);
+  if (next_event.type == Event::CPU_BURST_COMPLETED) handle_cpu_burst_complete(next_event);
+  if (next_event.type == Event::IO_BURST_COMPLETED) handle_io_burst_complete(next_event);
+  if (next_event.type == Event::THREAD_COMPLETED) handle_thread_complete(next_event);
+  if (next_event.type == Event::THREAD_PREEMPTED) handle_thread_preempted(next_event);
+}
+
 void Simulation::handle_thread_arrival(Event event)
 {
   /**
@@ -179,12 +419,14 @@ void Simulation::handle_thread_arrival(Event event)
   if (v_flag) vflag_output(event, "Transitioned from NEW to READY");
 }
 
-void Simulation::add_thread_to_ready_queue(shared_ptr<Thread> thread, int current_time)
+void Simulation::add_thread_to_ready_queue(shared_ptr<Thread> thread, SimTime current_time)
 {
   /**
    * Function to add thread to ready queue according to algorithm. PRIORITY and
-   * CUSTOM use separate queues from the other algorithms.
+   * CUSTOM use separate queues from the other algorithms. Sets the thread's
+   * ready_time, used for ready wait, affinity and CUSTOM aging.
    */
+  thread->ready_time = current_time;
   if (algorithm == PRIORITY)
   {
     Process::Type process_type = thread->process->type;
@@ -196,12 +438,17 @@ void Simulation::add_thread_to_ready_queue(shared_ptr<Thread> thread, int curren
     quantom = custom_ready_queue->dynamic_quantom;
   }
   else ready_queue.push(thread);
+  if (affinity_window > 0)
+  {
+    std::list<shared_ptr<Thread> >& same_process = process_ready_threads[thread->process->id];
+    thread->process_ready_position = same_process.insert(same_process.end(), thread);
+  }
   // If cpu is idle upon adding new ready thread, invoke dispatcher to dispatch it
   if (not running_thread)
     {
       Event e = Event(current_time, Event::DISPATCHER_INVOKED);
       e.thread = thread;
-      event_queue.push(e);
+      schedule(e);
     }
 }
 
@@ -212,23 +459,25 @@ void Simulation::handle_dispatcher_invoked(Event event)
    * add dispatch complete event to queue.
    */
   // Get thread to run from top of ready queue
-  shared_ptr<Thread> next_thread = get_next_thread();
+  shared_ptr<Thread> next_thread = get_next_thread(event.time);
+  next_thread->ready_wait_time = time_add(next_thread->ready_wait_time, event.time - next_thread->ready_time);
   Event e(event.time, -1);
   if (current_process_id != next_thread->process->id)
   {
     // Process switch
-    e.time += process_switch_overhead; 
+    e.time = time_add(e.time, process_switch_overhead); 
     e.type = Event::PROCESS_DISPATCH_COMPLETED;
   }
   else
   {
     // Thread switch
-    e.time += thread_switch_overhead; 
+    e.time = time_add(e.time, thread_switch_overhead); 
     e.type = Event::THREAD_DISPATCH_COMPLETED;
   }
   running_thread = next_thread;
   e.thread = next_thread;
-  event_queue.push(e);
+  schedule(e);
+  if (window_metrics) window_metrics->cpu_busy(event.time);
   // v_flag output
   if (v_flag)
   {
@@ -243,38 +492,68 @@ void Simulation::handle_dispatcher_invoked(Event event)
   }
 }
 
-shared_ptr<Thread> Simulation::get_next_thread()
+shared_ptr<Thread> Simulation::get_next_thread(SimTime current_time)
+{
+  /**
+   * Get next ready thread to run based on algorithm, and remove it from the
+   * ready queue. With an affinity window, a ready thread of the process that
+   * is already loaded is run instead of the algorithm's choice, saving a
+   * process switch, as long as the algorithm's choice has been ready for less
+   * than affinity_window. Threads of the same process are taken in the order
+   * they became ready.
+   */
+  shared_ptr<Thread> next_thread = peek_next_thread(current_time);
+  assert(next_thread != nullptr); // There must always be a ready thread if the dispatcher is invoked
+  if (affinity_window > 0 && next_thread->process->id != current_process_id
+      && current_time - next_thread->ready_time < affinity_window)
+  {
+    auto same_process = process_ready_threads.find(current_process_id);
+    if (same_process != process_ready_threads.end())
+    {
+      next_thread = same_process->second.front();
+      affinity_dispatches++;
+    }
+  }
+  remove_ready_thread(next_thread);
+  return next_thread;
+}
+
+shared_ptr<Thread> Simulation::peek_next_thread(SimTime current_time)
 {
   /**
-   * Get next ready thread to run based on algorithm.
+   * Get the thread the algorithm would run next without removing it.
    */
   if (algorithm == PRIORITY)
   {
     for(auto it = priority_ready_queues.begin(); it!=priority_ready_queues.end(); it++)
     {
-      if(not it->empty())
-      {
-        shared_ptr<Thread> next_thread = it->front();
-        it->pop();
-        return next_thread;
-      }
+      if(not it->empty()) return it->front();
     }
+    return nullptr;
   }
-  else if (algorithm == CUSTOM)
+  else if (algorithm == CUSTOM) return custom_ready_queue->front_thread(current_time);
+  else if (ready_queue.empty()) return nullptr; // Algorithm is not PRIORITY or CUSTOM
+  else return ready_queue.front();
+}
+
+void Simulation::remove_ready_thread(shared_ptr<Thread> thread)
+{
+  /**
+   * Remove a thread from the ready queue (and the per-process index) wherever
+   * it is.
+   */
+  if (algorithm == CUSTOM)
   {
-    shared_ptr<Thread> next_thread = custom_ready_queue->fetch_thread();
+    custom_ready_queue->remove_thread(thread);
     quantom = custom_ready_queue->dynamic_quantom; // Update quantom when ready queue changes
-    return next_thread;
   }
-  else // Algorithm is not PRIORITY or CUSTOM
+  else thread->ready_queue->erase(thread);
+  if (affinity_window > 0)
   {
-    shared_ptr<Thread> next_thread = ready_queue.front();
-    ready_queue.pop();
-    return next_thread;
+    auto same_process = process_ready_threads.find(thread->process->id);
+    same_process->second.erase(thread->process_ready_position);
+    if (same_process->second.empty()) process_ready_threads.erase(same_process);
   }
-  // This should never happen, there must always be something in the ready queue if the
-  // dispatcher is invoked
-  return nullptr;
 }
 
 void Simulation::handle_dispatch_complete(Event event)
@@ -285,21 +564,18 @@ void Simulation::handle_dispatch_complete(Event event)
    */
   assert(event.thread == running_thread);
   // Metrics
-  if (event.type == Event::PROCESS_DISPATCH_COMPLETED)
-  {
-    total_dispatch_time += process_switch_overhead;
-  }
-  else
-  {
-    total_dispatch_time += thread_switch_overhead;
-  }
+  SimTime overhead = (event.type == Event::PROCESS_DISPATCH_COMPLETED) ? process_switch_overhead : thread_switch_overhead;
+  total_dispatch_time = time_add(total_dispatch_time, overhead);
+  if (timeline) timeline->record(Timeline::DISPATCH, event.time - overhead, event.time,
+                                 event.thread->process->id, event.thread->id);
+  run_start_time = event.time;
   // Set status of running thread to running, set start time, set current process
   running_thread->state = "RUNNING";
   if (running_thread->start_time == -1) running_thread->start_time = event.time;
   current_process_id = event.thread->process->id;
   // Queue next event
   Event new_event = get_dispatch_end_event(event);
-  event_queue.push(new_event);
+  schedule(new_event);
   // v_flag output
   if (v_flag) vflag_output(event, "Transitioned from READY to RUNNING");
 }
@@ -308,32 +584,47 @@ Event Simulation::get_dispatch_end_event(Event dispatch_event)
 {
   /**
    * Gets the correct diapatch end event (preempt or cpu burst compelete)
-   * based on algorithm and current quantom/remaining burst time
+   * based on algorithm and current quantom/remaining burst time.
+   *
+   * With a warm-up model the thread first spends its warm-up penalty on the
+   * CPU without progress. Preemptive algorithms charge it to the quantom, but
+   * cap it so every quantom makes at least one unit of progress.
    */
   assert(running_thread == dispatch_event.thread);
   shared_ptr<Burst> next_burst = running_thread->bursts[running_thread->burst_index];
+  SimTime warmup = 0;
+  if (warmup_model)
+  {
+    warmup = warmup_model->penalty(*running_thread, dispatch_event.time);
+    if ((algorithm == RR or algorithm == CUSTOM) and warmup >= quantom) warmup = std::max<SimTime>(quantom - 1, 0);
+    total_warmup_time = time_add(total_warmup_time, warmup); // Metric
+    if (timeline && warmup > 0) timeline->record(Timeline::WARMUP, dispatch_event.time, dispatch_event.time + warmup,
+                                                 running_thread->process->id, running_thread->id);
+    run_start_time = time_add(dispatch_event.time, warmup);
+  }
+  SimTime start_time = time_add(dispatch_event.time, warmup);
   if (algorithm == FCFS or algorithm == PRIORITY)
   {
     // Non-preemptive, just complete burst
-    Event new_event = Event(dispatch_event.time + next_burst->cpu_time, Event::CPU_BURST_COMPLETED);
+    Event new_event = Event(time_add(start_time, next_burst->cpu_time), Event::CPU_BURST_COMPLETED);
     new_event.thread = running_thread;
     return new_event;
   }
   else // algorithm == RR or CUSTOM
   {
     // Preemeptive, check quantom to determine whether to preempt
-    int burst_amount_remaining = next_burst->cpu_time - running_thread->current_burst_completed_time;
-    if (burst_amount_remaining <= quantom) // No preempt necessary just complete the burst
+    SimTime burst_amount_remaining = next_burst->cpu_time - running_thread->current_burst_completed_time;
+    if (burst_amount_remaining <= quantom - warmup) // No preempt necessary just complete the burst
     {
-      Event new_event = Event(dispatch_event.time + burst_amount_remaining, Event::CPU_BURST_COMPLETED);
+      Event new_event = Event(time_add(start_time, burst_amount_remaining), Event::CPU_BURST_COMPLETED);
       new_event.thread = running_thread;
       return new_event;
     }
     else // Preempt after quantom
     {
-      Event new_event = Event(dispatch_event.time + quantom, Event::THREAD_PREEMPTED); 
+      Event new_event = Event(time_add(dispatch_event.time, quantom), Event::THREAD_PREEMPTED); 
       new_event.thread = running_thread;
-      new_event.thread->current_burst_completed_time += quantom;
+      new_event.thread->current_burst_completed_time += quantom - warmup;
       return new_event;
     }
   }
@@ -346,17 +637,24 @@ void Simulation::handle_cpu_burst_complete(Event event)
    * event to queue based on whether there are remaining bursts.
    */
   shared_ptr<Burst> current_burst = event.thread->bursts[event.thread->burst_index];
-  total_service_time += current_burst->cpu_time; // Metric
+  total_service_time = time_add(total_service_time, current_burst->cpu_time); // Metric
+  if (timeline) timeline->record(Timeline::RUNNING, run_start_time, event.time,
+                                 event.thread->process->id, event.thread->id);
+  event.thread->total_cpu_time = time_add(event.thread->total_cpu_time, current_burst->cpu_time);
   event.thread->current_burst_completed_time = 0; // For preemptive alogrithms, flag as not in middle of burst
+  event.thread->last_run_end = event.time;
+  event.thread->process->last_run_end = event.time;
   // Check for IO burst, determine whether to complete or block thread
   if(current_burst->io_time != 0)
   {
-    // Block for IO and add IO complete event to queue
+    // Block for IO, start it now unless its device has no free channel
     event.thread->state = "BLOCKED";
-    Event e = Event(event.time + current_burst->io_time, Event::IO_BURST_COMPLETED);
-    e.thread = event.thread;
-    e.burst = current_burst;
-    event_queue.push(e);
+    auto device = io_devices.find(current_burst->device);
+    IoRequest request = {event.thread, current_burst, event.time};
+    if (device == io_devices.end() || device->second.submit(request, event.time))
+    {
+      start_io(event.thread, current_burst, event.time);
+    }
     if (v_flag) vflag_output(event, "Transitioned from RUNNING to BLOCKED");
   }
   else
@@ -364,15 +662,16 @@ void Simulation::handle_cpu_burst_complete(Event event)
     // Complete thread
     Event e = Event(event.time, Event::THREAD_COMPLETED);
     e.thread = event.thread;
-    event_queue.push(e);
+    schedule(e);
     event.thread->state = "EXIT";
   }
   if (num_ready_threads() != 0){
     Event e = Event(event.time, Event::DISPATCHER_INVOKED);
-    event_queue.push(e);
+    schedule(e);
   }
   // Clear running thread, cpu is now idle
   running_thread = nullptr;
+  if (window_metrics) window_metrics->cpu_idle(event.time);
 }
 
 int Simulation::num_ready_threads()
@@ -396,12 +695,31 @@ int Simulation::num_ready_threads()
   else return ready_queue.size();
 }
 
+void Simulation::start_io(shared_ptr<Thread> thread, shared_ptr<Burst> burst, SimTime current_time)
+{
+  /**
+   * Add IO complete event for a burst whose IO starts now.
+   */
+  Event e = Event(time_add(current_time, burst->io_time), Event::IO_BURST_COMPLETED);
+  e.thread = thread;
+  e.burst = burst;
+  schedule(e);
+}
+
 void Simulation::handle_io_burst_complete(Event event)
 {
   /**
-   * Return thread to ready queue after IO burst.
+   * Return thread to ready queue after IO burst. The burst's device channel
+   * goes to the next queued request first.
    */
-  total_io_time += event.burst->io_time; // Metric
+  auto device = io_devices.find(event.burst->device);
+  IoRequest next_request;
+  if (device != io_devices.end() && device->second.complete(next_request, event.time))
+  {
+    start_io(next_request.thread, next_request.burst, event.time);
+  }
+  total_io_time = time_add(total_io_time, event.burst->io_time); // Metric
+  event.thread->total_io_time = time_add(event.thread->total_io_time, event.burst->io_time);
   event.thread->state = "READY";
   event.thread->burst_index++;
   add_thread_to_ready_queue(event.thread, event.time);
@@ -417,11 +735,17 @@ void Simulation::handle_thread_complete(Event event)
   // Metrics
   total_elapsed_time = event.time;
   event.thread->end_time = event.time;
+  live_threads--;
   // Process type data
   int proc_type = event.thread->process->type;
   process_type_data[proc_type][0] += 1; // Thread count
-  process_type_data[proc_type][1] += event.thread->start_time - event.thread->arrival_time; // Response time
-  process_type_data[proc_type][2] += event.thread->end_time - event.thread->arrival_time; // Turnaround time
+  process_type_data[proc_type][1] = time_add(process_type_data[proc_type][1],
+    event.thread->start_time - event.thread->arrival_time); // Response time
+  process_type_data[proc_type][2] = time_add(process_type_data[proc_type][2],
+    event.thread->end_time - event.thread->arrival_time); // Turnaround time
+  SimTime response_time = event.thread->start_time - event.thread->arrival_time;
+  if (response_time > process_type_data[proc_type][3]) process_type_data[proc_type][3] = response_time; // Max response time
+  if (window_metrics) window_metrics->thread_completed(proc_type, response_time);
   if(v_flag) vflag_output(event, "Transitioned from RUNNING to EXIT");
 }
 
@@ -430,8 +754,13 @@ void Simulation::handle_thread_preempted(Event event)
   /**
    * Update preempted thread, put on ready queue
    */
+  if (timeline) timeline->record(Timeline::RUNNING, run_start_time, event.time,
+                                 event.thread->process->id, event.thread->id);
   event.thread->state = "READY";
+  event.thread->last_run_end = event.time;
+  event.thread->process->last_run_end = event.time;
   running_thread = nullptr;
+  if (window_metrics) window_metrics->cpu_idle(event.time);
   add_thread_to_ready_queue(event.thread, event.time);
   // v-flag output
   if (v_flag) vflag_output(event, "Transitioned from RUNNING to READY");
@@ -450,16 +779,37 @@ void Simulation::vflag_output(Event event, std::string last_line)
   cout << "    " << last_line << "\n\n";
 }
 
+SimulationResults Simulation::get_results()
+{
+  /**
+   * Collect final simulation data.
+   *
+   * Returns totals, CPU utilization/efficiency (percent) and process type data.
+   */
+  SimulationResults results;
+  total_idle_time = total_elapsed_time - total_dispatch_time - total_service_time - total_warmup_time;
+  results.elapsed_time = total_elapsed_time;
+  results.service_time = total_service_time;
+  results.io_time = total_io_time;
+  results.dispatch_time = total_dispatch_time;
+  results.warmup_time = total_warmup_time;
+  results.idle_time = total_idle_time;
+  results.cpu_utilization = ((float)total_elapsed_time - (float)total_idle_time)/(float)total_elapsed_time;
+  results.cpu_efficiency = (float)total_service_time / (float)total_elapsed_time;
+  results.cpu_utilization *= 100;
+  results.cpu_efficiency *= 100;
+  results.process_type_data = process_type_data;
+  return results;
+}
+
 void Simulation::output_totals()
 {
   /**
    * Output final simulation data.
    */
-  total_idle_time = total_elapsed_time - total_dispatch_time - total_service_time;
-  float cpu_utilization = ((float)total_elapsed_time - (float)total_idle_time)/(float)total_elapsed_time;
-  float cpu_efficiency = (float)total_service_time / (float)total_elapsed_time;
-  cpu_utilization *= 100;
-  cpu_efficiency *= 100;
+  SimulationResults results = get_results();
+  float cpu_utilization = results.cpu_utilization;
+  float cpu_efficiency = results.cpu_efficiency;
   cout << std::left << std::setw(24) << "Total elapsed time:";
   cout  << std::right << std::setw(9) << std::to_string(total_elapsed_time) << "\n";
   cout << std::left << std::setw(24) << "Total service time:";
@@ -468,13 +818,35 @@ void Simulation::output_totals()
   cout  << std::right << std::setw(9) << std::to_string(total_io_time) << "\n";
   cout << std::left << std::setw(24) << "Total dispatch time:";
   cout  << std::right << std::setw(9) << std::to_string(total_dispatch_time) << "\n";
+  if (warmup_model)
+  {
+    // CPU time spent refilling caches, neither service nor idle
+    cout << std::left << std::setw(24) << "Total warm-up time:";
+    cout  << std::right << std::setw(9) << std::to_string(total_warmup_time) << "\n";
+  }
   cout << std::left << std::setw(24) << "Total idle time:";
   cout  << std::right << std::setw(9) << std::to_string(total_idle_time) << "\n";
+  if (affinity_window > 0)
+  {
+    // Estimate: each affinity dispatch counted as one process switch replaced by a
+    // thread switch. The schedule also changes, so the real difference in dispatch
+    // time against a run without affinity can be larger or smaller.
+    cout << std::left << std::setw(24) << "Affinity dispatches:";
+    cout  << std::right << std::setw(9) << std::to_string(affinity_dispatches) << "\n";
+    cout << std::left << std::setw(24) << "Est. dispatch saving:";
+    cout  << std::right << std::setw(9)
+          << std::to_string(affinity_dispatches * (process_switch_overhead - thread_switch_overhead)) << "\n";
+  }
   cout << "\n";
   cout << std::left <<std::setw(24) << "CPU utilization:";
   cout  << std::right << std::setw(8) << std::setprecision(2) << std::fixed << cpu_utilization << "%\n";
   cout << std::left <<std::setw(24) << "CPU efficiency:";
   cout  << std::right << std::setw(8) << std::setprecision(2) << std::fixed << cpu_efficiency << "%\n";
+  if (not io_devices.empty()) cout << "\n";
+  for (auto device = io_devices.begin(); device != io_devices.end(); device++)
+  {
+    device->second.output_stats(total_elapsed_time);
+  }
 }
 
 void Simulation::output_process_type_data()
@@ -483,16 +855,22 @@ void Simulation::output_process_type_data()
    * Final data for individual process types.
    */
   for(int type=0; type <= 3; type++){
-    float thr_count = (float) process_type_data[type][0];
-    float average_response_time = (float) process_type_data[type][1] / thr_count;
+    double thr_count = (double) process_type_data[type][0];
+    double average_response_time = (double) process_type_data[type][1] / thr_count;
     if (average_response_time != average_response_time) average_response_time = 0;
-    float average_turnaround_time = (float) process_type_data[type][2] / thr_count;
+    double average_turnaround_time = (double) process_type_data[type][2] / thr_count;
     if (average_turnaround_time != average_turnaround_time) average_turnaround_time = 0;
     cout << process_type_string(type) << " THREADS:\n";
     cout << std::left << std::setw(24) << "    Total count:";
     cout << std::right << std::setw(9) << process_type_data[type][0] << "\n"; // Actuall want the int here
     cout << std::left << std::setw(24) << "    Avg response time:";
     cout << std::right << std::setw(9) << std::setprecision(2) << std::fixed << average_response_time << "\n";
+    if (algorithm == CUSTOM)
+    {
+      // Measures the effect of --max_age, other algorithms keep the original report
+      cout << std::left << std::setw(24) << "    Max response time:";
+      cout << std::right << std::setw(9) << process_type_data[type][3] << "\n";
+    }
     cout << std::left << std::setw(24) << "    Avg turnaround time:";
     cout << std::right << std::setw(9) << std::setprecision(2) << std::fixed << average_turnaround_time << "\n";
     cout << "\n";
@@ -502,44 +880,29 @@ void Simulation::output_process_type_data()
 void Simulation::tflag_output()
 {
   /**
-   * Thread level data for --per_thread argument.
+   * Thread level data for --per_thread argument. Columns are written straight
+   * to the stream, "ARR: " plus a value padded to 7 gives the 12 wide column.
    */
+  cout << std::left;
   for(int i=0; i < processes.size(); i++)
   {
-    shared_ptr<Process> proc = processes[i];
+    shared_ptr<Process> const & proc = processes[i];
     cout << "Process " << proc->id << " [" << process_type_string(proc->type) << "]:\n";
     for(int j=0; j<proc->threads.size(); j++) 
     {
-      shared_ptr<Thread> thr = proc->threads[j];
-      cout << std::left << std::setw(15) << "    Thread " + std::to_string(thr->id) + ":";
-      cout << std::left << std::setw(12) << "ARR: " + std::to_string(thr->arrival_time);
-      cout << std::left << std::setw(12) << "CPU: " + std::to_string(total_burst_time(thr, true));
-      cout << std::left << std::setw(12) << "I/O: " + std::to_string(total_burst_time(thr, false));
-      cout << std::left << std::setw(12) << "TRT: " + std::to_string(thr->end_time - thr->arrival_time);
-      cout << std::left << std::setw(12) << "END: " + std::to_string(thr->end_time);
+      Thread const & thr = *proc->threads[j];
+      cout << std::setw(15) << "    Thread " + std::to_string(thr.id) + ":";
+      cout << "ARR: " << std::setw(7) << thr.arrival_time;
+      cout << "CPU: " << std::setw(7) << thr.total_cpu_time;
+      cout << "I/O: " << std::setw(7) << thr.total_io_time;
+      cout << "TRT: " << std::setw(7) << thr.end_time - thr.arrival_time;
+      cout << "END: " << std::setw(7) << thr.end_time;
       cout << "\n";
     }
     cout << "\n";
   }
 }
 
-int Simulation::total_burst_time(shared_ptr<Thread> thread, bool cpu_times)
-{
-  /**
-   * Calculate total burst time (cpu or io depending on cpu_times flag).
-   * 
-   * Returns total burst time (cpu or IO) for thread.
-   */
-  int total = 0;
-  for(int i=0; i < thread->bursts.size(); i++)
-  {
-    shared_ptr<Burst> burst = thread->bursts[i];
-    if (cpu_times) total += burst->cpu_time;
-    else total += burst->io_time;
-  }
-  return total;
-}
-
 std::string Simulation::process_type_string(int i)
 {
   /**
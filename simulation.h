@@ -13,25 +13,61 @@
 
 #include <vector>
 #include <queue>
+#include <list>
+#include <map>
+#include <unordered_map>
 #include <memory>
+#include <limits>
+#include <string>
 #include "process_structs.h"
+#include "event_queue.h"
+#include "io_device.h"
+#include "warmup.h"
+
+struct ReadyQueue
+{
+  bool empty() const;
+  size_t size() const;
+  std::shared_ptr<Thread> front() const;
+  void push(std::shared_ptr<Thread> thread);
+  void pop();
+  void erase(std::shared_ptr<Thread> thread);
+  std::list<std::shared_ptr<Thread> > threads;
+};
 
 struct CustomReadyQueue
 {
-  CustomReadyQueue();
-  std::vector<std::queue<std::shared_ptr<Thread> > > short_queues;
-  std::vector<std::queue<std::shared_ptr<Thread> > > long_queues;
+  CustomReadyQueue(SimTime max_age_arg);
+  std::vector<ReadyQueue> short_queues;
+  std::vector<ReadyQueue> long_queues;
+  ReadyQueue aged_queue;
   double dynamic_quantom;
   int num_threads;
-  int total_remaining_time;
-  int avg_age;
-  const int QUANTOM_MAX = 20;
-  std::shared_ptr<Thread> fetch_thread();
+  SimTime total_remaining_time;
+  SimTime max_age;
+  const SimTime QUANTOM_MAX = 20;
+  static const SimTime DEFAULT_MAX_AGE = 0; // Aging off unless --max_age is given
+  std::shared_ptr<Thread> fetch_thread(SimTime current_time);
+  std::shared_ptr<Thread> front_thread(SimTime current_time);
+  void remove_thread(std::shared_ptr<Thread> thread);
   void push_thread(std::shared_ptr<Thread>);
+  void promote_aged(SimTime current_time);
 };
 
-struct CompareEventsByArrivalTime{
-  bool operator()(Event const & e1, Event const & e2);
+struct WindowMetrics;
+class Timeline;
+
+struct SimulationResults
+{
+  SimTime elapsed_time;
+  SimTime service_time;
+  SimTime io_time;
+  SimTime dispatch_time;
+  SimTime warmup_time;
+  SimTime idle_time;
+  float cpu_utilization;
+  float cpu_efficiency;
+  std::vector<std::vector<SimTime> > process_type_data;
 };
 
 struct CompareThreadsByArrivalTime{
@@ -41,57 +77,92 @@ struct CompareThreadsByArrivalTime{
 class Simulation
 {
 public:
-  Simulation(int process_switch_overhead, int thread_switch_overhead);
+  Simulation(SimTime process_switch_overhead, SimTime thread_switch_overhead);
   void run_simulation();
+  SimulationResults simulate();
+  void start_simulation();
+  SimulationResults finish_simulation();
+  SimulationResults get_results();
+  int num_live_threads();
   void add_process(std::shared_ptr<Process> process);
+  void add_device(int id, int channels, int discipline);
+  void set_fast_queue(bool enabled);
+  // Streaming mode
+  void start_stream(SimTime window_size);
+  void add_thread(std::shared_ptr<Thread> thread);
+  void run_until(SimTime time_limit);
+  void finish_stream();
+  static std::string process_type_string(int type);
   std::shared_ptr<Event> next_event();
   std::vector<std::shared_ptr<Process> > get_processes();
   std::vector<std::shared_ptr<Thread> > get_threads();
   // Flags
   bool v_flag;
   bool t_flag;
-  int quantom;
+  SimTime quantom;
   int algorithm;
+  SimTime max_age;
+  std::string export_threads_file;
+  std::string timeline_file;
+  SimTime affinity_window;
+  std::shared_ptr<WarmupModel> warmup_model;
   static const int FCFS = 0;
   static const int RR = 1;
   static const int PRIORITY = 2;
   static const int CUSTOM = 3;
+  static const SimTime END_OF_TIME = std::numeric_limits<SimTime>::max();
 private:
+  void process_event(Event event);
+  void schedule(Event event);
   void handle_thread_arrival(Event event);
-  void add_thread_to_ready_queue(std::shared_ptr<Thread> thread, int current_time);
+  void add_thread_to_ready_queue(std::shared_ptr<Thread> thread, SimTime current_time);
   void handle_dispatcher_invoked(Event event);
-  std::shared_ptr<Thread> get_next_thread();
+  std::shared_ptr<Thread> get_next_thread(SimTime current_time);
+  std::shared_ptr<Thread> peek_next_thread(SimTime current_time);
+  void remove_ready_thread(std::shared_ptr<Thread> thread);
   void handle_dispatch_complete(Event event);
   Event get_dispatch_end_event(Event dispatch_event);
   void handle_cpu_burst_complete(Event event);
   void handle_io_burst_complete(Event event);
+  void start_io(std::shared_ptr<Thread> thread, std::shared_ptr<Burst> burst, SimTime current_time);
   void handle_thread_complete(Event event);
   void handle_thread_preempted(Event event);
-  std::string process_type_string(int type);
   std::string event_type_string(int type);
-  int total_burst_time(std::shared_ptr<Thread> thread, bool get_cpu_times);
   void vflag_output(Event event, std::string last_line);
   void output_totals();
   void output_process_type_data();
   void tflag_output();
   int num_ready_threads();
   // Metrics
-  int total_elapsed_time;
-  int total_dispatch_time;
-  int total_io_time;
-  int total_service_time;
-  int total_idle_time;
-  std::vector<std::vector<int> > process_type_data;
+  SimTime total_elapsed_time;
+  SimTime total_dispatch_time;
+  SimTime total_io_time;
+  SimTime total_service_time;
+  SimTime total_idle_time;
+  SimTime total_warmup_time;
+  long long affinity_dispatches;
+  int live_threads; // Added and not yet completed, including threads still to arrive
+  std::vector<std::vector<SimTime> > process_type_data;
   // Simulation data
-  int process_switch_overhead;
-  int thread_switch_overhead;
+  SimTime process_switch_overhead;
+  SimTime thread_switch_overhead;
   // Process objects/lists/queues
   std::shared_ptr<Thread> running_thread;
   std::vector<std::shared_ptr<Process> > processes;
-  std::priority_queue<Event, std::vector<Event>, CompareEventsByArrivalTime> event_queue;
-  std::queue<std::shared_ptr<Thread> > ready_queue;
-  std::vector<std::queue<std::shared_ptr<Thread> > > priority_ready_queues;
+  EventQueue event_queue;
+  ReadyQueue ready_queue;
+  std::vector<ReadyQueue> priority_ready_queues;
   int current_process_id;
+  // Ready threads of each process in ready order, only kept with affinity_window > 0
+  std::unordered_map<int, std::list<std::shared_ptr<Thread> > > process_ready_threads;
   std::shared_ptr<CustomReadyQueue> custom_ready_queue;
+  std::map<int, IoDevice> io_devices;
+  std::shared_ptr<WindowMetrics> window_metrics;
+  std::shared_ptr<Timeline> timeline;
+  SimTime run_start_time; // When the running thread's dispatch completed
+  // Fast path, next event when it is earlier than everything in event_queue (fast queue only)
+  bool fast_queue;
+  Event fast_event;
+  bool fast_event_pending;
 };
 #endif
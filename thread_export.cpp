@@ -0,0 +1,138 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * thread_export.cpp
+ * Implimentation of per-thread result export. All values come from totals
+ * accumulated during the simulation, nothing is recomputed from the bursts.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "process_structs.h"
+#include "thread_export.h"
+
+using std::shared_ptr;
+
+ThreadExporter::ThreadExporter(FILE* file_arg, bool csv_arg)
+  : file(file_arg), csv(csv_arg), buffer(BUFFER_SIZE), used(0)
+{}
+
+ThreadExporter::~ThreadExporter()
+{
+  flush();
+}
+
+void ThreadExporter::write_header(uint64_t rows)
+{
+  /**
+   * CSV column names, or the binary header.
+   */
+  if (csv)
+  {
+    for (int i = 0; i < EXPORT_COLUMNS; i++)
+    {
+      write_bytes(EXPORT_COLUMN_NAMES[i], strlen(EXPORT_COLUMN_NAMES[i]));
+      write_bytes((i == EXPORT_COLUMNS - 1) ? "\n" : ",", 1);
+    }
+  }
+  else
+  {
+    ExportHeader header;
+    memcpy(header.magic, "OSSIMTHR", 8);
+    header.version = 1;
+    header.columns = EXPORT_COLUMNS;
+    header.rows = rows;
+    write_bytes(&header, sizeof(header));
+  }
+}
+
+void ThreadExporter::write_thread(Process const & process, Thread const & thread)
+{
+  /**
+   * One row per thread, columns in EXPORT_COLUMN_NAMES order.
+   */
+  int64_t row[EXPORT_COLUMNS] = {
+    process.id, thread.id, process.type, thread.arrival_time, thread.start_time, thread.end_time,
+    thread.total_cpu_time, thread.total_io_time, thread.ready_wait_time
+  };
+  if (not csv)
+  {
+    write_bytes(row, sizeof(row));
+    return;
+  }
+  for (int i = 0; i < EXPORT_COLUMNS; i++) write_int(row[i], (i == EXPORT_COLUMNS - 1) ? '\n' : ',');
+}
+
+void ThreadExporter::write_bytes(void const * data, size_t size)
+{
+  if (used + size > buffer.size()) flush();
+  memcpy(&buffer[used], data, size);
+  used += size;
+}
+
+void ThreadExporter::write_int(int64_t value, char separator)
+{
+  /**
+   * Format value in decimal followed by separator, without going through
+   * a temporary string.
+   */
+  if (used + 22 > buffer.size()) flush();
+  char digits[20];
+  int count = 0;
+  uint64_t magnitude = (value < 0) ? -(uint64_t) value : (uint64_t) value;
+  do
+  {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) buffer[used++] = '-';
+  while (count > 0) buffer[used++] = digits[--count];
+  buffer[used++] = separator;
+}
+
+void ThreadExporter::flush()
+{
+  if (used != 0) fwrite(&buffer[0], 1, used, file);
+  used = 0;
+}
+
+bool export_threads(std::vector<shared_ptr<Process> > const & processes, std::string path)
+{
+  /**
+   * Write every thread's results to path, as CSV if path ends in .csv and as
+   * fixed-width binary records otherwise.
+   *
+   * Returns false if the file could not be written.
+   */
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr)
+  {
+    std::cout << "ERROR CANNOT WRITE EXPORT FILE " << path << "\n";
+    return false;
+  }
+  bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+  uint64_t rows = 0;
+  for (auto proc = processes.begin(); proc != processes.end(); proc++) rows += (*proc)->threads.size();
+  {
+    ThreadExporter exporter(file, csv);
+    exporter.write_header(rows);
+    for (auto proc = processes.begin(); proc != processes.end(); proc++)
+    {
+      for (auto thr = (*proc)->threads.begin(); thr != (*proc)->threads.end(); thr++)
+      {
+        exporter.write_thread(**proc, **thr);
+      }
+    }
+  } // Exporter flushes on destruction
+  bool ok = (ferror(file) == 0);
+  if (fclose(file) != 0) ok = false;
+  if (not ok) std::cout << "ERROR CANNOT WRITE EXPORT FILE " << path << "\n";
+  return ok;
+}
@@ -0,0 +1,56 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * thread_export.h
+ *
+ * Defines per-thread result export. Rows are written in one sequential pass
+ * through a large buffer, as CSV or as fixed-width binary records.
+ */
+
+#ifndef THREAD_EXPORT_H
+#define THREAD_EXPORT_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include "process_structs.h"
+
+// Binary layout: header, then one record of EXPORT_COLUMNS little-endian int64 per thread
+// in the column order of EXPORT_COLUMN_NAMES.
+struct ExportHeader
+{
+  char magic[8];      // "OSSIMTHR"
+  uint32_t version;   // 1
+  uint32_t columns;   // EXPORT_COLUMNS
+  uint64_t rows;
+};
+
+static const int EXPORT_COLUMNS = 9;
+static const char* const EXPORT_COLUMN_NAMES[EXPORT_COLUMNS] = {
+  "process_id", "thread_id", "process_type", "arrival", "start", "end", "cpu", "io", "ready_wait"
+};
+
+class ThreadExporter
+{
+public:
+  ThreadExporter(FILE* file_arg, bool csv_arg);
+  ~ThreadExporter();
+  void write_header(uint64_t rows);
+  void write_thread(Process const & process, Thread const & thread);
+private:
+  void write_bytes(void const * data, size_t size);
+  void write_int(int64_t value, char separator);
+  void flush();
+  FILE* file;
+  bool csv;
+  std::vector<char> buffer;
+  size_t used;
+  static const size_t BUFFER_SIZE = 1 << 22;
+};
+
+bool export_threads(std::vector<std::shared_ptr<Process> > const & processes, std::string path);
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * timeline.cpp
+ * Implimentation of the CPU timeline recorder.
+ *
+ * Compact encoding: "OSSIMTL1", then one record per interval. Intervals are
+ * contiguous from time 0, so only kind and duration are stored: a kind byte,
+ * the duration as a LEB128 varint, and for RUNNING/DISPATCH/WARMUP the process and
+ * thread ids as varints.
+ *
+ * JSON encoding: Chrome trace format ("X" complete events on a single track),
+ * loadable in chrome://tracing or Perfetto.
+ */
+
+
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <iostream>
+#include "process_structs.h"
+#include "timeline.h"
+
+Timeline::Timeline(FILE* file_arg, bool json_arg)
+  : file(file_arg), json(json_arg), first_json_event(true), has_pending(false), last_end(0)
+{
+  setvbuf(file, nullptr, _IOFBF, 1 << 22);
+  if (json) fputs("{\"traceEvents\":[\n", file);
+  else fwrite("OSSIMTL1", 1, 8, file);
+}
+
+Timeline::~Timeline()
+{
+  if (has_pending) write_interval(pending);
+  if (json) fputs("\n]}\n", file);
+  fclose(file);
+}
+
+void Timeline::record(int kind, SimTime start, SimTime end, int process_id, int thread_id)
+{
+  /**
+   * Record that the CPU was in state kind from start to end. Gaps since the
+   * previous interval are recorded as IDLE. An interval that continues the
+   * pending one (same kind, thread and no gap) extends it instead of being
+   * written.
+   */
+  if (start > last_end) record(IDLE, last_end, start, -1, -1);
+  if (end <= start) return; // Nothing to draw
+  last_end = end;
+  if (has_pending && pending.kind == kind && pending.end == start
+    && pending.process_id == process_id && pending.thread_id == thread_id)
+  {
+    pending.end = end;
+    return;
+  }
+  if (has_pending) write_interval(pending);
+  pending.kind = kind;
+  pending.start = start;
+  pending.end = end;
+  pending.process_id = process_id;
+  pending.thread_id = thread_id;
+  has_pending = true;
+}
+
+void Timeline::write_interval(TimelineInterval const & interval)
+{
+  if (not json)
+  {
+    fputc(interval.kind, file);
+    write_varint(interval.end - interval.start);
+    if (interval.kind != IDLE)
+    {
+      write_varint(interval.process_id);
+      write_varint(interval.thread_id);
+    }
+    return;
+  }
+  static const char* const NAMES[] = {"IDLE", "DISPATCH", "RUNNING", "WARMUP"};
+  if (not first_json_event) fputs(",\n", file);
+  first_json_event = false;
+  if (interval.kind == IDLE)
+  {
+    fprintf(file, "{\"name\":\"IDLE\",\"cat\":\"IDLE\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":0}",
+      (long long) interval.start, (long long) (interval.end - interval.start));
+  }
+  else
+  {
+    fprintf(file, "{\"name\":\"P%d T%d\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":0,\"tid\":0,"
+      "\"args\":{\"process\":%d,\"thread\":%d}}",
+      interval.process_id, interval.thread_id, NAMES[interval.kind],
+      (long long) interval.start, (long long) (interval.end - interval.start),
+      interval.process_id, interval.thread_id);
+  }
+}
+
+void Timeline::write_varint(uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    fputc((value & 0x7f) | 0x80, file);
+    value >>= 7;
+  }
+  fputc(value, file);
+}
+
+std::shared_ptr<Timeline> open_timeline(std::string path)
+{
+  /**
+   * Open a timeline file, Chrome trace JSON if path ends in .json and the
+   * compact encoding otherwise.
+   *
+   * Returns pointer to the timeline, nullptr if the file could not be opened.
+   */
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr)
+  {
+    std::cout << "ERROR CANNOT WRITE TIMELINE FILE " << path << "\n";
+    return nullptr;
+  }
+  bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+  return std::make_shared<Timeline>(file, json);
+}
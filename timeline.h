@@ -0,0 +1,54 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * timeline.h
+ *
+ * Defines the CPU timeline recorder. CPU occupancy is recorded as RUNNING,
+ * WARMUP, DISPATCH and IDLE intervals, adjacent intervals of the same kind
+ * are coalesced and written out as they close, so memory use is constant.
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <string>
+#include <memory>
+#include <cstdio>
+#include "process_structs.h"
+
+struct TimelineInterval
+{
+  int kind;
+  SimTime start;
+  SimTime end;
+  int process_id;
+  int thread_id;
+};
+
+class Timeline
+{
+public:
+  Timeline(FILE* file_arg, bool json_arg);
+  ~Timeline();
+  void record(int kind, SimTime start, SimTime end, int process_id, int thread_id);
+  // Interval kinds
+  static const int IDLE = 0;
+  static const int DISPATCH = 1;
+  static const int RUNNING = 2;
+  static const int WARMUP = 3;
+private:
+  void write_interval(TimelineInterval const & interval);
+  void write_varint(uint64_t value);
+  FILE* file;
+  bool json;
+  bool first_json_event;
+  bool has_pending;
+  TimelineInterval pending;
+  SimTime last_end;
+};
+
+std::shared_ptr<Timeline> open_timeline(std::string path);
+
+#endif
@@ -0,0 +1,412 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * trace_import.cpp
+ * Implimentation of the scheduler trace importer.
+ *
+ * Every task (kernel pid) is followed through RUNNING, READY and BLOCKED.
+ * CPU time is summed from switch in to switch out, across preemptions, until
+ * the task blocks. The burst's IO time lasts from then until the task is woken
+ * (or next switched in, if the wakeup was not captured). A task that exits or
+ * is still around at the end of the trace finishes with its last CPU burst.
+ * Times are microseconds from the first record. Absolute trace times are
+ * kept 64-bit and only the time from the first record is narrowed to SimTime.
+ */
+
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <map>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+#include <limits>
+#include "process_structs.h"
+#include "trace_import.h"
+
+using std::shared_ptr;
+
+static bool find_int(const char* text, const char* key, int& value)
+{
+  /**
+   * Find " key=" in text and parse the integer after it.
+   */
+  const char* found = strstr(text, key);
+  if (found == nullptr) return false;
+  value = atoi(found + strlen(key));
+  return true;
+}
+
+static int parse_task_token(const char* begin, const char* end, int& tgid)
+{
+  /**
+   * Parse the task at the start of a record: "comm-pid" (ftrace),
+   * "pid" or "tgid/pid" (perf script).
+   *
+   * Returns the pid, -1 if none was found.
+   */
+  const char* slash = nullptr;
+  const char* dash = nullptr;
+  for (const char* p = begin; p < end; p++)
+  {
+    if (*p == '/') slash = p;
+    if (*p == '-') dash = p;
+  }
+  if (slash != nullptr && isdigit(*begin) && isdigit(slash[1]))
+  {
+    tgid = atoi(begin);
+    return atoi(slash + 1);
+  }
+  if (dash != nullptr && isdigit(dash[1])) return atoi(dash + 1);
+  if (begin < end && isdigit(*begin)) return atoi(begin);
+  return -1;
+}
+
+bool TraceImporter::parse_line(char* line, SchedRecord& record)
+{
+  /**
+   * Parse one line of ftrace or perf sched script output. Lines look like
+   *   bash-1234  (1230) [001] d..3  52.000107: sched_switch: prev_comm=bash prev_pid=1234 ...
+   *   bash  1230/1234 [001]  52.000107:  sched:sched_switch: prev_comm=bash prev_pid=1234 ...
+   * where the (tgid) column and the tgid/ prefix only appear when the trace
+   * was recorded with them. Fields are found by key, so comm names with
+   * spaces and the differing flag columns do not matter.
+   *
+   * Returns false for lines that are not sched_switch or sched_wakeup records.
+   */
+  char* event = strstr(line, "sched_switch: ");
+  if (event != nullptr) record.type = SchedRecord::SWITCH;
+  else
+  {
+    event = strstr(line, "sched_wakeup"); // Also sched_wakeup_new
+    if (event == nullptr) return false;
+    record.type = SchedRecord::WAKEUP;
+  }
+  // The timestamp is the "seconds.fraction:" token before the event name
+  char* time_end = event;
+  while (time_end > line && time_end[-1] != ' ') time_end--;
+  while (time_end > line && time_end[-1] == ' ') time_end--;
+  if (time_end == line || time_end[-1] != ':') return false;
+  char* time_begin = time_end - 1;
+  while (time_begin > line && time_begin[-1] != ' ') time_begin--;
+  char* fraction;
+  long long seconds = strtoll(time_begin, &fraction, 10);
+  if (fraction == time_begin) return false;
+  long long micros = 0;
+  int digits = 0;
+  if (*fraction == '.')
+  {
+    for (char* p = fraction + 1; isdigit(*p) && digits < 6; p++, digits++) micros = micros * 10 + (*p - '0');
+  }
+  for (; digits < 6; digits++) micros *= 10;
+  record.time = seconds * 1000000 + micros;
+  // Task emitting the record, just before the [cpu] column
+  record.current_pid = -1;
+  record.current_tgid = -1;
+  char* cpu = strstr(line, " [");
+  while (cpu != nullptr && cpu < time_begin && not isdigit(cpu[2])) cpu = strstr(cpu + 1, " [");
+  if (cpu != nullptr && cpu < time_begin)
+  {
+    char* token_end = cpu;
+    while (token_end > line && token_end[-1] == ' ') token_end--;
+    if (token_end > line && token_end[-1] == ')')
+    {
+      // ftrace "(tgid)" column
+      char* open = token_end - 1;
+      while (open > line && *open != '(') open--;
+      char* tgid = open + 1;
+      while (*tgid == ' ') tgid++;
+      if (isdigit(*tgid)) record.current_tgid = atoi(tgid);
+      token_end = open;
+      while (token_end > line && token_end[-1] == ' ') token_end--;
+    }
+    char* token_begin = token_end;
+    while (token_begin > line && token_begin[-1] != ' ') token_begin--;
+    record.current_pid = parse_task_token(token_begin, token_end, record.current_tgid);
+  }
+  // Event fields
+  if (record.type == SchedRecord::SWITCH)
+  {
+    const char* state = strstr(event, " prev_state=");
+    record.prev_state = (state != nullptr) ? state[12] : 'S';
+    return find_int(event, " prev_pid=", record.pid) && find_int(event, " prev_prio=", record.prio)
+      && find_int(event, " next_pid=", record.next_pid) && find_int(event, " next_prio=", record.next_prio);
+  }
+  return find_int(event, " pid=", record.pid) && find_int(event, " prio=", record.prio);
+}
+
+Process::Type TraceImporter::priority_type(int prio)
+{
+  /**
+   * Map a kernel priority to a process type: real-time (0-99) is SYSTEM,
+   * negative nice (100-119) INTERACTIVE, nice 0 NORMAL and positive nice BATCH.
+   */
+  if (prio < 100) return Process::SYSTEM;
+  if (prio < 120) return Process::INTERACTIVE;
+  if (prio == 120) return Process::NORMAL;
+  return Process::BATCH;
+}
+
+TraceImporter::TraceImporter()
+  : start_time(0), last_time(0), num_records(0)
+{}
+
+bool TraceImporter::import_file(std::string path)
+{
+  /**
+   * Read the trace in rounds of one CHUNK_SIZE chunk per hardware thread.
+   * Each round is split at line boundaries and parsed in parallel, then its
+   * records are folded into the task states in file order. The partial line
+   * at the end of a round is carried into the next one.
+   *
+   * Returns false if the file could not be read.
+   */
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+  {
+    std::cout << "ERROR CANNOT READ TRACE FILE " << path << "\n";
+    return false;
+  }
+  unsigned num_workers = std::max(1u, std::thread::hardware_concurrency());
+  size_t round_size = num_workers * CHUNK_SIZE;
+  std::vector<char> buffer(round_size + 1);
+  std::vector<std::vector<SchedRecord> > records(num_workers);
+  size_t carried = 0;
+  bool end_of_file = false;
+  while (not end_of_file)
+  {
+    size_t size = carried + fread(&buffer[carried], 1, round_size - carried, file);
+    end_of_file = (size < round_size);
+    size_t parse_size = size;
+    if (not end_of_file)
+    {
+      while (parse_size > 0 && buffer[parse_size - 1] != '\n') parse_size--;
+      if (parse_size == 0) parse_size = size; // Line longer than a round, cut it
+    }
+    parse_round(buffer, parse_size, records);
+    for (auto worker = records.begin(); worker != records.end(); worker++)
+    {
+      for (auto record = worker->begin(); record != worker->end(); record++) fold(*record);
+    }
+    carried = size - parse_size;
+    memmove(&buffer[0], &buffer[parse_size], carried);
+  }
+  bool ok = (ferror(file) == 0);
+  fclose(file);
+  if (not ok)
+  {
+    std::cout << "ERROR CANNOT READ TRACE FILE " << path << "\n";
+    return false;
+  }
+  // Tasks still alive at the end of the trace finish with what they have run
+  for (auto task = tasks.begin(); task != tasks.end(); task++)
+  {
+    if (task->second.state == TraceTask::RUNNING) task->second.cpu_time += last_time - start_time - task->second.since;
+    finish_task(task->second);
+  }
+  tasks.clear();
+  return true;
+}
+
+void TraceImporter::parse_round(std::vector<char>& buffer, size_t size, std::vector<std::vector<SchedRecord> >& records)
+{
+  /**
+   * Parse buffer[0, size) into records, one line-aligned slice per worker.
+   */
+  size_t num_workers = records.size();
+  std::vector<size_t> bounds(num_workers + 1, size);
+  bounds[0] = 0;
+  for (size_t i = 1; i < num_workers; i++)
+  {
+    size_t bound = std::max(bounds[i - 1], size * i / num_workers);
+    while (bound < size && bound > 0 && buffer[bound - 1] != '\n') bound++;
+    bounds[i] = bound;
+  }
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers; i++)
+  {
+    workers.push_back(std::thread([&buffer, &bounds, &records, i]() {
+      std::vector<SchedRecord>& out = records[i];
+      out.clear();
+      char* line = &buffer[bounds[i]];
+      char* end = &buffer[bounds[i + 1]];
+      while (line < end)
+      {
+        char* newline = static_cast<char*>(memchr(line, '\n', end - line));
+        if (newline == nullptr) newline = end;
+        char saved = *newline;
+        *newline = '\0';
+        SchedRecord record;
+        if (*line != '#' && parse_line(line, record)) out.push_back(record);
+        *newline = saved;
+        line = newline + 1;
+      }
+    }));
+  }
+  for (auto worker = workers.begin(); worker != workers.end(); worker++) worker->join();
+}
+
+void TraceImporter::fold(SchedRecord const & record)
+{
+  /**
+   * Apply one record to the task states. Records that step back in time
+   * (merged per-CPU buffers) are treated as happening at the latest time seen.
+   */
+  if (num_records++ == 0) start_time = last_time = record.time;
+  if (record.time > last_time) last_time = record.time;
+  if (last_time - start_time > std::numeric_limits<SimTime>::max())
+  {
+    std::cerr << "ERROR TIME OUT OF RANGE: trace spans " << last_time - start_time
+              << " microseconds, rebuild without COMPACT_TIME\n";
+    exit(1);
+  }
+  SimTime time = last_time - start_time; // In range, checked above
+  if (record.current_tgid > 0 && record.current_pid > 0) tgids[record.current_pid] = record.current_tgid;
+  if (record.type == SchedRecord::SWITCH)
+  {
+    if (record.pid != 0) // pid 0 is the idle task
+    {
+      TraceTask& prev = tasks[record.pid];
+      prev.prio = record.prio;
+      switch_out(prev, record.pid, record.prev_state, time);
+    }
+    if (record.next_pid != 0)
+    {
+      TraceTask& next = tasks[record.next_pid];
+      next.prio = record.next_prio;
+      if (next.state != TraceTask::READY && next.state != TraceTask::RUNNING) make_runnable(next, record.next_pid, time);
+      next.state = TraceTask::RUNNING;
+      next.since = time;
+    }
+  }
+  else if (record.pid != 0)
+  {
+    TraceTask& task = tasks[record.pid];
+    task.prio = record.prio;
+    if (task.state == TraceTask::UNKNOWN || task.state == TraceTask::BLOCKED) make_runnable(task, record.pid, time);
+  }
+}
+
+void TraceImporter::switch_out(TraceTask& task, int pid, char prev_state, SimTime time)
+{
+  /**
+   * Task left the CPU. R (or R+) means it was preempted and is still ready,
+   * X/Z that it exited, anything else that it blocked.
+   */
+  if (task.state == TraceTask::RUNNING) task.cpu_time += time - task.since;
+  if (task.state == TraceTask::UNKNOWN)
+  {
+    // First sight of a task that was already running, start following it once it is ready
+    if (prev_state == 'R') make_runnable(task, pid, time);
+    return;
+  }
+  if (prev_state == 'R') task.state = TraceTask::READY;
+  else if (prev_state == 'X' || prev_state == 'Z')
+  {
+    finish_task(task);
+    return;
+  }
+  else task.state = TraceTask::BLOCKED;
+  task.since = time;
+}
+
+void TraceImporter::make_runnable(TraceTask& task, int pid, SimTime time)
+{
+  /**
+   * Task became ready: a new thread arrives, or a blocked one ends its IO.
+   */
+  if (task.thread_index == -1)
+  {
+    TraceThread thread;
+    thread.pid = pid;
+    thread.prio = task.prio;
+    thread.arrival_time = time;
+    task.thread_index = threads.size();
+    task.cpu_time = 0;
+    threads.push_back(thread);
+  }
+  else if (task.state == TraceTask::BLOCKED) end_burst(task, time - task.since);
+  task.state = TraceTask::READY;
+  task.since = time;
+}
+
+void TraceImporter::end_burst(TraceTask& task, SimTime io_time)
+{
+  /**
+   * Close the burst in progress. IO shorter than the trace resolution is
+   * folded into the next burst, since only a thread's last burst may have
+   * no IO. Every CPU burst is at least 1 so the simulator always advances.
+   */
+  if (io_time <= 0) return;
+  threads[task.thread_index].bursts.push_back(std::make_pair(std::max<SimTime>(task.cpu_time, 1), io_time));
+  task.cpu_time = 0;
+}
+
+void TraceImporter::finish_task(TraceTask& task)
+{
+  /**
+   * Close the task's thread: its last burst has no IO. A reused pid starts a
+   * new thread.
+   */
+  if (task.thread_index != -1)
+  {
+    std::vector<std::pair<SimTime, SimTime> >& bursts = threads[task.thread_index].bursts;
+    if (task.cpu_time > 0) bursts.push_back(std::make_pair(task.cpu_time, (SimTime) 0));
+    else if (not bursts.empty()) bursts.back().second = 0;
+  }
+  task.state = TraceTask::UNKNOWN;
+  task.cpu_time = 0;
+  task.thread_index = -1;
+}
+
+std::vector<shared_ptr<Process> > TraceImporter::get_processes()
+{
+  /**
+   * Build the workload. Tasks are grouped into processes by thread group
+   * where the trace shows it (otherwise every task is its own process), and
+   * a process's type comes from the priority of its first thread. Threads
+   * that never ran are dropped.
+   *
+   * Returns processes in process id order, threads in arrival order.
+   */
+  std::map<int, shared_ptr<Process> > processes;
+  for (auto trace_thread = threads.begin(); trace_thread != threads.end(); trace_thread++)
+  {
+    if (trace_thread->bursts.empty()) continue;
+    auto tgid = tgids.find(trace_thread->pid);
+    int proc_id = (tgid != tgids.end()) ? tgid->second : trace_thread->pid;
+    shared_ptr<Process>& process = processes[proc_id];
+    if (not process) process = std::make_shared<Process>(proc_id, priority_type(trace_thread->prio));
+    shared_ptr<Thread> thread = std::make_shared<Thread>(trace_thread->arrival_time, process->threads.size(), process);
+    for (auto burst = trace_thread->bursts.begin(); burst != trace_thread->bursts.end(); burst++)
+    {
+      thread->bursts.push_back(std::make_shared<Burst>(burst->first, burst->second, thread));
+    }
+    process->threads.push_back(thread);
+  }
+  std::vector<shared_ptr<Process> > result;
+  for (auto process = processes.begin(); process != processes.end(); process++) result.push_back(process->second);
+  return result;
+}
+
+std::vector<shared_ptr<Process> > import_sched_trace(std::string path)
+{
+  /**
+   * Import a scheduler trace as a workload.
+   *
+   * Returns the processes, empty if the file could not be read or held no
+   * scheduler records.
+   */
+  TraceImporter importer;
+  if (not importer.import_file(path)) return std::vector<shared_ptr<Process> >();
+  std::vector<shared_ptr<Process> > processes = importer.get_processes();
+  if (processes.empty()) std::cout << "ERROR NO SCHEDULER RECORDS IN TRACE FILE " << path << "\n";
+  return processes;
+}
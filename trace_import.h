@@ -0,0 +1,88 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * trace_import.h
+ *
+ * Defines the scheduler trace importer. sched_switch and sched_wakeup records
+ * from ftrace text output or perf sched script output are turned into
+ * processes, threads and CPU/IO bursts. The file is read in fixed size rounds
+ * that are parsed in parallel, so memory does not grow with the file size.
+ */
+
+#ifndef TRACE_IMPORT_H
+#define TRACE_IMPORT_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include "process_structs.h"
+
+struct SchedRecord
+{
+  int64_t time;      // Microseconds, absolute (trace clocks can exceed SimTime)
+  int type;
+  int current_pid;   // Task that emitted the record
+  int current_tgid;  // Its thread group if the trace shows it, -1 otherwise
+  int pid;           // SWITCH: prev_pid, WAKEUP: woken pid
+  int prio;          // SWITCH: prev_prio, WAKEUP: prio
+  char prev_state;   // SWITCH only
+  int next_pid;      // SWITCH only
+  int next_prio;     // SWITCH only
+  // Record types
+  static const int SWITCH = 0;
+  static const int WAKEUP = 1;
+};
+
+struct TraceTask
+{
+  TraceTask() : state(UNKNOWN), since(0), cpu_time(0), prio(120), thread_index(-1) {}
+  int state;
+  SimTime since;      // When the task entered state
+  SimTime cpu_time;   // CPU time of the burst in progress
+  int prio;
+  int thread_index;   // Index into TraceImporter::threads, -1 before the task is first runnable
+  // Task states
+  static const int UNKNOWN = 0;
+  static const int READY = 1;
+  static const int RUNNING = 2;
+  static const int BLOCKED = 3;
+};
+
+struct TraceThread
+{
+  int pid;
+  int prio;
+  SimTime arrival_time;
+  std::vector<std::pair<SimTime, SimTime> > bursts; // (cpu_time, io_time)
+};
+
+class TraceImporter
+{
+public:
+  TraceImporter();
+  bool import_file(std::string path);
+  std::vector<std::shared_ptr<Process> > get_processes();
+  static bool parse_line(char* line, SchedRecord& record);
+  static Process::Type priority_type(int prio);
+private:
+  void parse_round(std::vector<char>& buffer, size_t size, std::vector<std::vector<SchedRecord> >& records);
+  void fold(SchedRecord const & record);
+  void switch_out(TraceTask& task, int pid, char prev_state, SimTime time);
+  void make_runnable(TraceTask& task, int pid, SimTime time);
+  void end_burst(TraceTask& task, SimTime io_time);
+  void finish_task(TraceTask& task);
+  std::unordered_map<int, TraceTask> tasks;
+  std::unordered_map<int, int> tgids;
+  std::vector<TraceThread> threads;
+  int64_t start_time;
+  int64_t last_time;
+  long long num_records;
+  static const size_t CHUNK_SIZE = 1 << 22;
+};
+
+std::vector<std::shared_ptr<Process> > import_sched_trace(std::string path);
+
+#endif
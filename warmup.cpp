@@ -0,0 +1,97 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * warmup.cpp
+ * Implimentation of cache warm-up cost models.
+ */
+
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "process_structs.h"
+#include "warmup.h"
+
+WarmupModel::WarmupModel(SimTime max_penalty_arg, bool process_scope_arg)
+  : process_scope(process_scope_arg), max_penalty(max_penalty_arg)
+{}
+
+SimTime WarmupModel::penalty(Thread const & thread, SimTime current_time) const
+{
+  /**
+   * Warm-up penalty for dispatching thread at current_time. A thread (or
+   * process) that has never run starts fully cold.
+   */
+  SimTime last_run_end = process_scope ? thread.process->last_run_end : thread.last_run_end;
+  if (last_run_end < 0) return max_penalty;
+  return penalty_after(current_time - last_run_end);
+}
+
+DecayWarmup::DecayWarmup(SimTime max_penalty_arg, double tau_arg, bool process_scope_arg)
+  : WarmupModel(max_penalty_arg, process_scope_arg), tau(tau_arg)
+{}
+
+SimTime DecayWarmup::penalty_after(SimTime off_cpu_time) const
+{
+  return std::llround(max_penalty * (1 - std::exp(-off_cpu_time / tau)));
+}
+
+LinearWarmup::LinearWarmup(SimTime max_penalty_arg, SimTime ramp_arg, bool process_scope_arg)
+  : WarmupModel(max_penalty_arg, process_scope_arg), ramp(ramp_arg)
+{}
+
+SimTime LinearWarmup::penalty_after(SimTime off_cpu_time) const
+{
+  if (off_cpu_time >= ramp) return max_penalty;
+  return (SimTime) ((double) max_penalty * off_cpu_time / ramp);
+}
+
+std::shared_ptr<WarmupModel> make_warmup_model(std::string spec)
+{
+  /**
+   * Build a model from a -W --warmup argument:
+   *   decay:MAX:TAU[:process] or linear:MAX:RAMP[:process]
+   *
+   * Returns pointer to the model, nullptr if spec is malformed.
+   */
+  std::replace(spec.begin(), spec.end(), ':', ' ');
+  std::stringstream stream(spec);
+  std::vector<std::string> fields;
+  std::string field;
+  while (stream >> field) fields.push_back(field);
+  if (fields.size() < 3 || fields.size() > 4) return nullptr;
+  bool process_scope = false;
+  if (fields.size() == 4)
+  {
+    if (fields[3] != "process") return nullptr;
+    process_scope = true;
+  }
+  try
+  {
+    SimTime max_penalty = std::stoll(fields[1]);
+    if (max_penalty < 0) return nullptr;
+    if (fields[0] == "decay")
+    {
+      double tau = std::stod(fields[2]);
+      if (tau <= 0) return nullptr;
+      return std::make_shared<DecayWarmup>(max_penalty, tau, process_scope);
+    }
+    if (fields[0] == "linear")
+    {
+      SimTime ramp = std::stoll(fields[2]);
+      if (ramp <= 0) return nullptr;
+      return std::make_shared<LinearWarmup>(max_penalty, ramp, process_scope);
+    }
+  }
+  catch (std::exception const &)
+  {
+    return nullptr;
+  }
+  return nullptr;
+}
@@ -0,0 +1,53 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * warmup.h
+ *
+ * Defines cache warm-up cost models. A dispatched thread first spends a
+ * penalty refilling its cache before its burst makes progress, the penalty
+ * grows with how long the thread (or its process) has been off the CPU.
+ */
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <string>
+#include <memory>
+#include "process_structs.h"
+
+struct WarmupModel
+{
+  WarmupModel(SimTime max_penalty_arg, bool process_scope_arg);
+  virtual ~WarmupModel() {}
+  SimTime penalty(Thread const & thread, SimTime current_time) const;
+  bool process_scope; // Measure time off the CPU for the whole process, not just the thread
+protected:
+  virtual SimTime penalty_after(SimTime off_cpu_time) const = 0;
+  SimTime max_penalty;
+};
+
+// penalty = MAX * (1 - exp(-off_cpu_time / TAU))
+struct DecayWarmup : WarmupModel
+{
+  DecayWarmup(SimTime max_penalty_arg, double tau_arg, bool process_scope_arg);
+protected:
+  SimTime penalty_after(SimTime off_cpu_time) const;
+private:
+  double tau;
+};
+
+// penalty = MAX * min(off_cpu_time / RAMP, 1)
+struct LinearWarmup : WarmupModel
+{
+  LinearWarmup(SimTime max_penalty_arg, SimTime ramp_arg, bool process_scope_arg);
+protected:
+  SimTime penalty_after(SimTime off_cpu_time) const;
+private:
+  SimTime ramp;
+};
+
+std::shared_ptr<WarmupModel> make_warmup_model(std::string spec);
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * window_metrics.cpp
+ * Implimentation of sliding-window metrics. Only the current window's
+ * completions are kept, so memory is bounded by the completions per window.
+ */
+
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include "simulation.h"
+#include "window_metrics.h"
+
+using std::cout;
+
+WindowMetrics::WindowMetrics(SimTime window_size_arg)
+  : window_size(window_size_arg), window_start(0), response_times(4),
+    busy_time(0), busy(false), last_busy_update(0)
+{
+  assert(window_size > 0); // advance would never leave an empty window
+}
+
+void WindowMetrics::advance(SimTime time)
+{
+  /**
+   * Emit every window that ends at or before time. Callers must have
+   * processed all events before time.
+   */
+  while (window_start + window_size <= time) emit();
+}
+
+void WindowMetrics::finish(SimTime time)
+{
+  /**
+   * Emit every window up to and including the one containing time.
+   */
+  advance(time);
+  emit();
+}
+
+void WindowMetrics::cpu_busy(SimTime time)
+{
+  /**
+   * CPU starts dispatching or running a thread.
+   */
+  accrue_busy(time);
+  busy = true;
+}
+
+void WindowMetrics::cpu_idle(SimTime time)
+{
+  /**
+   * CPU stops running a thread.
+   */
+  accrue_busy(time);
+  busy = false;
+}
+
+void WindowMetrics::thread_completed(int process_type, SimTime response_time)
+{
+  response_times[process_type].push_back(response_time);
+}
+
+void WindowMetrics::accrue_busy(SimTime time)
+{
+  /**
+   * Add busy time since the last update, the window is always emitted before
+   * time passes its end so this never spills into the next window.
+   */
+  if (busy) busy_time += time - last_busy_update;
+  last_busy_update = time;
+}
+
+SimTime WindowMetrics::percentile(std::vector<SimTime>& values, int pct)
+{
+  /**
+   * Nearest-rank percentile, partially reorders values.
+   *
+   * Returns the pct-th percentile of values, 0 if empty.
+   */
+  if (values.empty()) return 0;
+  size_t rank = (values.size() * pct + 99) / 100;
+  if (rank == 0) rank = 1;
+  std::nth_element(values.begin(), values.begin() + (rank - 1), values.end());
+  return values[rank - 1];
+}
+
+void WindowMetrics::emit()
+{
+  /**
+   * Output the current window and start the next one.
+   */
+  SimTime window_end = time_add(window_start, window_size);
+  accrue_busy(window_end);
+  cout << "WINDOW [" << window_start << ", " << window_end << "):\n";
+  for (int type = 0; type <= 3; type++)
+  {
+    std::vector<SimTime>& values = response_times[type];
+    float throughput = (float) values.size() / (float) window_size;
+    cout << "    " << std::left << std::setw(12) << Simulation::process_type_string(type);
+    cout << "done: " << std::right << std::setw(6) << values.size();
+    cout << "  tput: " << std::setw(7) << std::setprecision(3) << std::fixed << throughput;
+    cout << "  p50: " << std::setw(7) << percentile(values, 50);
+    cout << "  p95: " << std::setw(7) << percentile(values, 95);
+    cout << "  p99: " << std::setw(7) << percentile(values, 99) << "\n";
+    values.clear();
+  }
+  float cpu_utilization = 100 * (float) busy_time / (float) window_size;
+  cout << "    " << std::left << std::setw(12) << "CPU" << "utilization: ";
+  cout << std::right << std::setw(6) << std::setprecision(2) << std::fixed << cpu_utilization << "%\n\n";
+  cout << std::flush; // Windows are read live
+  busy_time = 0;
+  window_start = window_end;
+}
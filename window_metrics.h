@@ -0,0 +1,41 @@
+/**
+ * Operating Systems
+ * Project 2 - OS Scheduling Simulator
+ * Alec De Vivo
+ *
+ * window_metrics.h
+ *
+ * Defines sliding-window metrics for streaming simulations: per-type
+ * throughput and response time percentiles, and CPU utilization, reported
+ * every window_size time units.
+ */
+
+#ifndef WINDOW_METRICS_H
+#define WINDOW_METRICS_H
+
+#include <vector>
+#include <string>
+#include "process_structs.h"
+
+struct WindowMetrics
+{
+  WindowMetrics(SimTime window_size_arg);
+  void advance(SimTime time);
+  void finish(SimTime time);
+  void cpu_busy(SimTime time);
+  void cpu_idle(SimTime time);
+  void thread_completed(int process_type, SimTime response_time);
+  SimTime window_size;
+  SimTime window_start;
+  // Current window data, cleared on every emit
+  std::vector<std::vector<SimTime> > response_times;
+  SimTime busy_time;
+  bool busy;
+  SimTime last_busy_update;
+private:
+  void accrue_busy(SimTime time);
+  void emit();
+  SimTime percentile(std::vector<SimTime>& values, int pct);
+};
+
+#endif